@@ -33,9 +33,30 @@ typedef enum {
     ESP8266_TIMEOUT = 2
 } ESP8266_Status_t;
 
+typedef struct {
+    uint32_t overrun;               /* ORE: byte lost before it was read */
+    uint32_t framing;               /* FE: missing stop bit (baud mismatch, noisy wiring) */
+    uint32_t noise;                 /* NE: noise detected while sampling a bit */
+    uint32_t parity;                /* PE: parity mismatch (only with parity enabled) */
+    uint32_t dma;                   /* DTE: DMA transfer error */
+    uint32_t rx_restarts;           /* Receptions restarted after a blocking error */
+    uint32_t dma_laps;              /* DMA overwrote data before it was processed */
+    uint32_t dma_lost_bytes;        /* Bytes skipped because of those laps */
+    uint32_t dma_peak_pending;      /* Largest backlog seen by ESP8266_ProcessDMAData() */
+} ESP8266_UART_ErrorStats_t;
+
 /* Exported constants --------------------------------------------------------*/
 #define ESP8266_BUFFER_SIZE         512
+
+/* Circular DMA buffer: must hold the largest burst received between two
+   ESP8266_ProcessDMAData() calls - size it from dma_peak_pending. */
+#ifndef ESP8266_DMA_BUFFER_SIZE
 #define ESP8266_DMA_BUFFER_SIZE     256
+#endif
+
+#if (ESP8266_DMA_BUFFER_SIZE < 2) || ((ESP8266_DMA_BUFFER_SIZE & (ESP8266_DMA_BUFFER_SIZE - 1)) != 0)
+#error "ESP8266_DMA_BUFFER_SIZE must be a power of two"
+#endif
 
 /* AT Commands */
 #define AT_CMD_TEST                 "AT\r\n"
@@ -47,7 +68,8 @@ typedef enum {
 #define AT_CMD_MQTT_USER_CFG        "AT+MQTTUSERCFG=0,1,\"%s\",\"\",\"\",0,0,\"\"\r\n"
 #define AT_CMD_MQTT_CONNECT         "AT+MQTTCONN=0,\"%s\",%d,1\r\n"
 #define AT_CMD_MQTT_SUBSCRIBE       "AT+MQTTSUB=0,\"%s\",1\r\n"
-#define AT_CMD_MQTT_PUBLISH         "AT+MQTTPUB=0,\"%s\",\"%s\",1,0\r\n"
+#define AT_CMD_MQTT_PUBLISH         "AT+MQTTPUB=0,\"%s\",\"%s\",%d,%d\r\n"
+#define AT_CMD_UART_CONFIG          "AT+UART_CUR=%lu,8,1,0,%d\r\n"
 
 /* Response Strings */
 #define AT_RESP_OK                  "OK"
@@ -68,13 +90,19 @@ extern uint8_t esp8266_dma_buffer[ESP8266_DMA_BUFFER_SIZE];
 
 /* Exported function prototypes ---------------------------------------------*/
 ESP8266_Status_t ESP8266_Init(UART_HandleTypeDef* huart);
+ESP8266_Status_t ESP8266_ConfigureUART(uint32_t baudrate, bool flow_control);
 ESP8266_Status_t ESP8266_ConnectWiFi(const char* ssid, const char* password);
 ESP8266_Status_t ESP8266_ConnectMQTT(const char* broker_ip, uint16_t port, const char* client_id);
 ESP8266_Status_t ESP8266_SubscribeMQTT(const char* topic);
 ESP8266_Status_t ESP8266_PublishMQTT(const char* topic, const char* message);
+ESP8266_Status_t ESP8266_PublishMQTTEx(const char* topic, const char* message, uint8_t qos, bool retain);
 ESP8266_Status_t ESP8266_SendCommand(const char* command, const char* expected_response, uint32_t timeout);
 void ESP8266_ProcessDMAData(void);
 void ESP8266_ClearBuffer(void);
+void ESP8266_UART_ErrorCallback(UART_HandleTypeDef* huart);
+void ESP8266_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart);
+void ESP8266_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void ESP8266_GetUARTErrorStats(ESP8266_UART_ErrorStats_t* stats);
 
 /* Callback function prototypes */
 void ESP8266_OnMQTTMessageReceived(const char* topic, const char* message);
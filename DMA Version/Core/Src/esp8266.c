@@ -24,13 +24,24 @@ static UART_HandleTypeDef* esp8266_uart = NULL;
 
 /* DMA variables */
 uint8_t esp8266_dma_buffer[ESP8266_DMA_BUFFER_SIZE];
-static uint16_t dma_old_pos = 0;
+static volatile uint32_t dma_rx_halves = 0;     // Half/full transfer events since reception start
+static uint32_t dma_read_total = 0;             // Bytes consumed since reception start
+
+/* UART error recovery */
+static volatile ESP8266_UART_ErrorStats_t uart_error_stats;
+static volatile bool dma_rx_restarted = false;  // Set by the error ISR, handled by ProcessDMAData
+static volatile bool dma_abort_valid = false;   // Aborted transfer's tail can still be drained
+static volatile uint16_t dma_abort_pos = 0;     // Write position when the transfer was aborted
+static bool rx_resync = false;                  // Dropping bytes until the next line boundary
 
 /* Private function prototypes -----------------------------------------------*/
 static ESP8266_Status_t ESP8266_WaitForResponse(const char* expected, uint32_t timeout);
 static void ESP8266_UART_Transmit(const char* data);
 static void ESP8266_ProcessBuffer(void);
 static void ESP8266_ProcessDMAByte(uint8_t data);
+static uint32_t ESP8266_DMAWriteTotal(void);
+static void ESP8266_HandleRxRestart(void);
+static void ESP8266_DiscardPartialLine(void);
 
 /* Exported functions --------------------------------------------------------*/
 
@@ -49,6 +60,8 @@ ESP8266_Status_t ESP8266_Init(UART_HandleTypeDef* huart)
     ESP8266_ClearBuffer();
     
     // Start DMA reception in circular mode
+    dma_rx_halves = 0;
+    dma_read_total = 0;
     if (HAL_UART_Receive_DMA(esp8266_uart, esp8266_dma_buffer, ESP8266_DMA_BUFFER_SIZE) != HAL_OK) {
         return ESP8266_ERROR;
     }
@@ -58,7 +71,7 @@ ESP8266_Status_t ESP8266_Init(UART_HandleTypeDef* huart)
     
     // Clear any startup messages
     ESP8266_ClearBuffer();
-    dma_old_pos = ESP8266_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(esp8266_uart->hdmarx);
+    dma_read_total = ESP8266_DMAWriteTotal();
     
     // Test basic communication - multiple attempts with proper delays
     ESP8266_Status_t status = ESP8266_TIMEOUT;
@@ -95,6 +108,50 @@ ESP8266_Status_t ESP8266_Init(UART_HandleTypeDef* huart)
 }
 
 
+/**
+  * @brief  Set the module's UART baud rate and RTS/CTS flow control
+  * @note   Uses AT+UART_CUR (not saved to flash), call again after every reset.
+  *         The MCU UART follows the new baud rate; its HwFlowCtl must already
+  *         match flow_control.
+  * @param  baudrate: New baud rate
+  * @param  flow_control: true to enable RTS/CTS on the module
+  * @retval ESP8266_Status_t
+  */
+ESP8266_Status_t ESP8266_ConfigureUART(uint32_t baudrate, bool flow_control)
+{
+    char command[64];
+    
+    if (esp8266_uart == NULL) {
+        return ESP8266_ERROR;
+    }
+    
+    snprintf(command, sizeof(command), AT_CMD_UART_CONFIG, (unsigned long)baudrate, flow_control ? 3 : 0);
+    if (ESP8266_SendCommand(command, AT_RESP_OK, AT_TIMEOUT_DEFAULT) != ESP8266_OK) {
+        return ESP8266_ERROR;
+    }
+    
+    if (baudrate == esp8266_uart->Init.BaudRate) {
+        return ESP8266_OK;
+    }
+    
+    // The module answered "OK" at the old rate and has switched - follow it
+    HAL_UART_AbortReceive(esp8266_uart);
+    esp8266_uart->Init.BaudRate = baudrate;
+    if (HAL_UART_Init(esp8266_uart) != HAL_OK) {
+        return ESP8266_ERROR;
+    }
+    
+    ESP8266_ClearBuffer();
+    dma_rx_halves = 0;
+    dma_read_total = 0;
+    if (HAL_UART_Receive_DMA(esp8266_uart, esp8266_dma_buffer, ESP8266_DMA_BUFFER_SIZE) != HAL_OK) {
+        return ESP8266_ERROR;
+    }
+    
+    // Confirm the link at the new rate
+    return ESP8266_SendCommand(AT_CMD_TEST, AT_RESP_OK, AT_TIMEOUT_DEFAULT);
+}
+
 /**
   * @brief  Connect to WiFi network
   * @param  ssid: WiFi network name
@@ -153,15 +210,28 @@ ESP8266_Status_t ESP8266_SubscribeMQTT(const char* topic)
 }
 
 /**
-  * @brief  Publish message to MQTT topic
+  * @brief  Publish message to MQTT topic (QoS 1, not retained)
   * @param  topic: MQTT topic
   * @param  message: Message to publish
   * @retval ESP8266_Status_t
   */
 ESP8266_Status_t ESP8266_PublishMQTT(const char* topic, const char* message)
+{
+    return ESP8266_PublishMQTTEx(topic, message, 1, false);
+}
+
+/**
+  * @brief  Publish message to MQTT topic with explicit QoS and retain flag
+  * @param  topic: MQTT topic
+  * @param  message: Message to publish
+  * @param  qos: 0, 1 or 2
+  * @param  retain: true to have the broker keep it for later subscribers
+  * @retval ESP8266_Status_t
+  */
+ESP8266_Status_t ESP8266_PublishMQTTEx(const char* topic, const char* message, uint8_t qos, bool retain)
 {
     char command[256];
-    snprintf(command, sizeof(command), AT_CMD_MQTT_PUBLISH, topic, message);
+    snprintf(command, sizeof(command), AT_CMD_MQTT_PUBLISH, topic, message, qos, retain ? 1 : 0);
     return ESP8266_SendCommand(command, AT_RESP_OK, AT_TIMEOUT_DEFAULT);
 }
 
@@ -181,8 +251,10 @@ ESP8266_Status_t ESP8266_SendCommand(const char* command, const char* expected_r
     // Clear both DMA processing buffer AND internal buffer
     ESP8266_ClearBuffer();
     
-    // Reset DMA position to start fresh
-    dma_old_pos = ESP8266_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(esp8266_uart->hdmarx);
+    // Reset DMA position to start fresh (a pending error restart is moot now)
+    dma_rx_restarted = false;
+    rx_resync = false;
+    dma_read_total = ESP8266_DMAWriteTotal();
     
     // Send command
     ESP8266_UART_Transmit(command);
@@ -201,24 +273,39 @@ void ESP8266_ProcessDMAData(void)
         return;
     }
     
-    uint16_t pos = ESP8266_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(esp8266_uart->hdmarx);
-    
-    if (pos != dma_old_pos) {
-        if (pos > dma_old_pos) {
-            // Linear case - no buffer wrap
-            for (uint16_t i = dma_old_pos; i < pos; i++) {
-                ESP8266_ProcessDMAByte(esp8266_dma_buffer[i]);
-            }
-        } else {
-            // Wrap-around case - buffer has wrapped
-            for (uint16_t i = dma_old_pos; i < ESP8266_DMA_BUFFER_SIZE; i++) {
-                ESP8266_ProcessDMAByte(esp8266_dma_buffer[i]);
-            }
-            for (uint16_t i = 0; i < pos; i++) {
-                ESP8266_ProcessDMAByte(esp8266_dma_buffer[i]);
-            }
+    // Reception was restarted after a UART error - DMA now writes from index 0.
+    // The error ISR can also fire while the write position is read; that
+    // total belongs to the new transfer while dma_read_total still counts the
+    // old one, so handle the restart and read it again
+    uint32_t write_total;
+    do {
+        if (dma_rx_restarted) {
+            ESP8266_HandleRxRestart();
         }
-        dma_old_pos = pos;
+        write_total = ESP8266_DMAWriteTotal();
+    } while (dma_rx_restarted);
+    
+    uint32_t pending = write_total - dma_read_total;
+    
+    if (pending > uart_error_stats.dma_peak_pending) {
+        uart_error_stats.dma_peak_pending = pending;
+    }
+    
+    if (pending > ESP8266_DMA_BUFFER_SIZE) {
+        // DMA lapped us: the oldest bytes are gone and the rest is being
+        // overwritten. Keep only the newest half and resync on a line boundary
+        uint32_t skip = pending - ESP8266_DMA_BUFFER_SIZE / 2;
+        uart_error_stats.dma_laps++;
+        uart_error_stats.dma_lost_bytes += skip;
+        dma_read_total += skip;
+        ESP8266_DiscardPartialLine();
+        rx_resync = true;
+    }
+    
+    // Buffer size is a power of two, so the running totals wrap cleanly
+    while (dma_read_total != write_total) {
+        ESP8266_ProcessDMAByte(esp8266_dma_buffer[dma_read_total % ESP8266_DMA_BUFFER_SIZE]);
+        dma_read_total++;
     }
 }
 
@@ -232,6 +319,149 @@ void ESP8266_ClearBuffer(void)
     esp8266_buffer_index = 0;
 }
 
+/**
+  * @brief  UART error handler, call from HAL_UART_ErrorCallback()
+  * @note   Runs in interrupt context. HAL aborts circular DMA reception on any
+  *         receive error, so it is restarted here and the main loop drains the
+  *         aborted transfer on its next ESP8266_ProcessDMAData() call.
+  * @param  huart: UART handle that reported the error
+  * @retval None
+  */
+void ESP8266_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+    if (esp8266_uart == NULL || huart != esp8266_uart) {
+        return;
+    }
+    
+    uint32_t error = huart->ErrorCode;
+    if (error & HAL_UART_ERROR_ORE) uart_error_stats.overrun++;
+    if (error & HAL_UART_ERROR_FE)  uart_error_stats.framing++;
+    if (error & HAL_UART_ERROR_NE)  uart_error_stats.noise++;
+    if (error & HAL_UART_ERROR_PE)  uart_error_stats.parity++;
+    if (error & HAL_UART_ERROR_DMA) uart_error_stats.dma++;
+    
+    // Reading SR then DR clears PE/FE/NE/ORE
+    __HAL_UART_CLEAR_PEFLAG(huart);
+    
+    if (huart->RxState == HAL_UART_STATE_READY) {
+        // A second error before the main loop caught up means the old tail
+        // may already be overwritten by the restarted transfer
+        dma_abort_valid = !dma_rx_restarted;
+        dma_abort_pos = ESP8266_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(huart->hdmarx);
+        dma_rx_restarted = true;
+        dma_rx_halves = 0;
+        uart_error_stats.rx_restarts++;
+        
+        HAL_UART_Receive_DMA(huart, esp8266_dma_buffer, ESP8266_DMA_BUFFER_SIZE);
+    }
+}
+
+/**
+  * @brief  DMA half transfer handler, call from HAL_UART_RxHalfCpltCallback()
+  * @param  huart: UART handle
+  * @retval None
+  */
+void ESP8266_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+    if (huart == esp8266_uart) {
+        dma_rx_halves++;
+    }
+}
+
+/**
+  * @brief  DMA transfer complete (wrap) handler, call from HAL_UART_RxCpltCallback()
+  * @param  huart: UART handle
+  * @retval None
+  */
+void ESP8266_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+    if (huart == esp8266_uart) {
+        dma_rx_halves++;
+    }
+}
+
+/**
+  * @brief  Get UART error counters
+  * @param  stats: Destination for a snapshot of the counters
+  * @retval None
+  */
+void ESP8266_GetUARTErrorStats(ESP8266_UART_ErrorStats_t* stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    
+    __disable_irq();
+    *stats = uart_error_stats;
+    __enable_irq();
+}
+
+/**
+  * @brief  Total bytes written by DMA since reception started
+  * @note   Combines the half/full transfer event count with the DMA counter,
+  *         so the main loop can tell how many times the buffer wrapped.
+  * @retval Running byte count (wraps at 2^32)
+  */
+static uint32_t ESP8266_DMAWriteTotal(void)
+{
+    const uint32_t half = ESP8266_DMA_BUFFER_SIZE / 2;
+    uint32_t halves;
+    uint32_t pos;
+    
+    do {
+        halves = dma_rx_halves;
+        pos = (ESP8266_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(esp8266_uart->hdmarx)) % ESP8266_DMA_BUFFER_SIZE;
+    } while (halves != dma_rx_halves);
+    
+    // After n events DMA writes in half (n % 2); if it is already in the other
+    // half, that boundary's interrupt is still pending
+    if ((pos / half) != (halves % 2)) {
+        halves++;
+    }
+    
+    return halves * half + (pos % half);
+}
+
+/**
+  * @brief  Resume processing after reception was restarted
+  * @retval None
+  */
+static void ESP8266_HandleRxRestart(void)
+{
+    __disable_irq();
+    bool tail_valid = dma_abort_valid;
+    uint16_t abort_pos = dma_abort_pos;
+    dma_rx_restarted = false;
+    __enable_irq();
+    
+    // Drain what the aborted transfer wrote; a part that wrapped to the start
+    // of the buffer is already being overwritten by the new transfer
+    if (tail_valid) {
+        uint16_t start = dma_read_total % ESP8266_DMA_BUFFER_SIZE;
+        uint16_t end = (abort_pos >= start) ? abort_pos : ESP8266_DMA_BUFFER_SIZE;
+        for (uint16_t i = start; i < end; i++) {
+            ESP8266_ProcessDMAByte(esp8266_dma_buffer[i]);
+        }
+    }
+    
+    // The line in progress lost a byte - drop it and resync on the next one,
+    // complete lines (e.g. an "OK" being waited for) are kept
+    ESP8266_DiscardPartialLine();
+    rx_resync = true;
+    dma_read_total = 0;
+}
+
+/**
+  * @brief  Remove an incomplete trailing line from the buffer
+  * @retval None
+  */
+static void ESP8266_DiscardPartialLine(void)
+{
+    while (esp8266_buffer_index > 0 && esp8266_buffer[esp8266_buffer_index - 1] != '\n') {
+        esp8266_buffer[--esp8266_buffer_index] = '\0';
+    }
+}
+
 /**
   * @brief  Wait for expected response
   * @param  expected: Expected response string
@@ -343,6 +573,14 @@ static void ESP8266_ProcessBuffer(void)
   */
 static void ESP8266_ProcessDMAByte(uint8_t data)
 {
+    // After a receive error, skip the rest of the damaged line
+    if (rx_resync) {
+        if (data == '\n') {
+            rx_resync = false;
+        }
+        return;
+    }
+    
     // Filter characters - only process printable ASCII and CR/LF
     if ((data >= 0x20 && data <= 0x7E) || data == '\r' || data == '\n') {
         if (esp8266_buffer_index < ESP8266_BUFFER_SIZE - 1) {
@@ -24,6 +24,7 @@
 #include "esp8266.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -40,10 +41,16 @@
 /* MQTT Configuration */
 #define MQTT_BROKER_IP              "192.168.1.XXX"
 #define MQTT_BROKER_PORT            1883
-#define MQTT_CLIENT_ID              "STM32_LED_Controller"
+#define MQTT_CLIENT_ID              "STM32_LED_Controller"   // "_<device id>" is appended
 #define MQTT_TOPIC_LED_CONTROL      "led/control"
 #define MQTT_TOPIC_LED_STATUS       "led/status"
-#define MQTT_TOPIC_STATUS_REQUEST   "led/status_request"
+#define MQTT_TOPIC_STATUS_REQUEST   "led/status_request"     // also subscribed unprefixed (fleet-wide request)
+
+/* Device ID, used as topic prefix ("<id>/led/control"). Leave empty to use the
+   STM32's 96-bit unique ID (24 hex digits) so every board gets its own topics. */
+#define MQTT_DEVICE_ID              ""
+#define MQTT_DEVICE_ID_MAX_LEN      32
+#define MQTT_TOPIC_MAX_LEN          64
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -60,6 +67,12 @@ DMA_HandleTypeDef hdma_usart2_tx;
 static bool led_state = false;
 static char status_message[50];
 static bool status_update_pending = false;  // Flag for deferred status updates
+static uint32_t command_seq = 0;            // Sequence number of the last command, echoed as "#<seq>"
+static char device_id[MQTT_DEVICE_ID_MAX_LEN + 1];
+static char mqtt_client_id[sizeof(MQTT_CLIENT_ID) + MQTT_DEVICE_ID_MAX_LEN + 1];
+static char topic_led_control[MQTT_TOPIC_MAX_LEN];
+static char topic_led_status[MQTT_TOPIC_MAX_LEN];
+static char topic_status_request[MQTT_TOPIC_MAX_LEN];
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -69,7 +82,11 @@ static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
 void LED_Control(bool state);
+static void MQTT_BuildTopics(void);
 void ESP8266_OnMQTTMessageReceived(const char* topic, const char* message);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -113,20 +130,29 @@ int main(void)
   // Initialize LED to OFF state
   LED_Control(false);
   
+  // Per-device MQTT client ID and topics
+  MQTT_BuildTopics();
+  
   // Initialize ESP8266 WiFi module with UART2
   if (ESP8266_Init(&huart2) == ESP8266_OK) {
+#if ESP8266_UART_FLOW_CONTROL || (ESP8266_UART_BAUDRATE != 115200)
+    // Move the link to the configured speed / flow control (stays at 115200 on failure)
+    ESP8266_ConfigureUART(ESP8266_UART_BAUDRATE, ESP8266_UART_FLOW_CONTROL);
+#endif
     // Connect to WiFi
     if (ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK) {        // Connect to MQTT broker
-        if (ESP8266_ConnectMQTT(MQTT_BROKER_IP, MQTT_BROKER_PORT, MQTT_CLIENT_ID) == ESP8266_OK) {
+        if (ESP8266_ConnectMQTT(MQTT_BROKER_IP, MQTT_BROKER_PORT, mqtt_client_id) == ESP8266_OK) {
           // Subscribe to LED control topic
-          ESP8266_SubscribeMQTT(MQTT_TOPIC_LED_CONTROL);
+          ESP8266_SubscribeMQTT(topic_led_control);
           
-          // Subscribe to status request topic (optional enhancement)
+          // Subscribe to status requests for this device and for the whole fleet
+          ESP8266_SubscribeMQTT(topic_status_request);
           ESP8266_SubscribeMQTT(MQTT_TOPIC_STATUS_REQUEST);
           
           // Publish initial status (LED starts OFF)
-          snprintf(status_message, sizeof(status_message), "STM32 Connected - LED: %s", led_state ? "ON" : "OFF");
-          ESP8266_PublishMQTT(MQTT_TOPIC_LED_STATUS, status_message);
+          snprintf(status_message, sizeof(status_message), "STM32 Connected - LED: %s #%lu",
+                   led_state ? "ON" : "OFF", (unsigned long)command_seq);
+          ESP8266_PublishMQTTEx(topic_led_status, status_message, 1, MQTT_STATUS_RETAIN);
         }
     }
   }
@@ -146,8 +172,9 @@ int main(void)
     // Handle deferred status updates (avoid sending from interrupt context)
     if (status_update_pending) {
       status_update_pending = false;
-      snprintf(status_message, sizeof(status_message), "LED: %s", led_state ? "ON" : "OFF");
-      ESP8266_PublishMQTT(MQTT_TOPIC_LED_STATUS, status_message);
+      snprintf(status_message, sizeof(status_message), "LED: %s #%lu",
+               led_state ? "ON" : "OFF", (unsigned long)command_seq);
+      ESP8266_PublishMQTTEx(topic_led_status, status_message, 1, MQTT_STATUS_RETAIN);
     }
   }
   /* USER CODE END 3 */
@@ -221,6 +248,14 @@ static void MX_USART2_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART2_Init 2 */
+#if ESP8266_UART_FLOW_CONTROL
+  // RTS/CTS on PA1/PA0 (pins muxed in HAL_UART_MspInit)
+  huart2.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+  if (HAL_UART_Init(&huart2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
 
   /* USER CODE END USART2_Init 2 */
 
@@ -298,6 +333,28 @@ void LED_Control(bool state)
     status_update_pending = true;
 }
 
+/**
+  * @brief  Build the device ID, MQTT client ID and per-device topics
+  * @note   Topics become "<device id>/led/..." so one broker and dashboard
+  *         can serve many boards (the server subscribes to "+/led/status")
+  * @retval None
+  */
+static void MQTT_BuildTopics(void)
+{
+    if (MQTT_DEVICE_ID[0] != '\0') {
+        snprintf(device_id, sizeof(device_id), "%s", MQTT_DEVICE_ID);
+    } else {
+        // 96-bit unique ID, most significant word first
+        snprintf(device_id, sizeof(device_id), "%08lX%08lX%08lX",
+                 (unsigned long)HAL_GetUIDw2(), (unsigned long)HAL_GetUIDw1(), (unsigned long)HAL_GetUIDw0());
+    }
+    
+    snprintf(mqtt_client_id, sizeof(mqtt_client_id), "%s_%s", MQTT_CLIENT_ID, device_id);
+    snprintf(topic_led_control, sizeof(topic_led_control), "%s/%s", device_id, MQTT_TOPIC_LED_CONTROL);
+    snprintf(topic_led_status, sizeof(topic_led_status), "%s/%s", device_id, MQTT_TOPIC_LED_STATUS);
+    snprintf(topic_status_request, sizeof(topic_status_request), "%s/%s", device_id, MQTT_TOPIC_STATUS_REQUEST);
+}
+
 /**
   * @brief  MQTT message received callback
   * @param  topic: MQTT topic
@@ -306,23 +363,69 @@ void LED_Control(bool state)
   */
 void ESP8266_OnMQTTMessageReceived(const char* topic, const char* message)
 {
-    if (strcmp(topic, MQTT_TOPIC_LED_CONTROL) == 0) {
+    if (strcmp(topic, topic_led_control) == 0) {
+        // Split an optional "#<seq>" suffix ("on#42") off the command; the
+        // sequence number is echoed in the status so the server can match it
+        char command[16];
+        const char* seq = strchr(message, '#');
+        size_t length = seq ? (size_t)(seq - message) : strlen(message);
+        if (length >= sizeof(command)) {
+            length = sizeof(command) - 1;
+        }
+        memcpy(command, message, length);
+        command[length] = '\0';
+        
         // Handle both uppercase and lowercase commands
-        if (strcmp(message, "ON") == 0 || strcmp(message, "on") == 0 || 
-            strcmp(message, "1") == 0) {
+        if (strcmp(command, "ON") == 0 || strcmp(command, "on") == 0 || 
+            strcmp(command, "1") == 0) {
 
+            command_seq = seq ? strtoul(seq + 1, NULL, 10) : 0;
             LED_Control(true);
-        } else if (strcmp(message, "OFF") == 0 || strcmp(message, "off") == 0 || 
-                   strcmp(message, "0") == 0) {
+        } else if (strcmp(command, "OFF") == 0 || strcmp(command, "off") == 0 || 
+                   strcmp(command, "0") == 0) {
 
+            command_seq = seq ? strtoul(seq + 1, NULL, 10) : 0;
             LED_Control(false);
         }
-    } else if (strcmp(topic, MQTT_TOPIC_STATUS_REQUEST) == 0) {
+    } else if (strcmp(topic, topic_status_request) == 0 ||
+               strcmp(topic, MQTT_TOPIC_STATUS_REQUEST) == 0) {
         // Handle status request - immediately publish current status
         status_update_pending = true;
     }
 }
 
+/**
+  * @brief  UART error callback
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    // Clear ORE/FE/NE and restart ESP8266 reception (HAL stops DMA on errors)
+    ESP8266_UART_ErrorCallback(huart);
+}
+
+/**
+  * @brief  UART receive half complete callback (circular DMA)
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    // Count buffer halves so the driver can detect DMA lapping the reader
+    ESP8266_UART_RxHalfCpltCallback(huart);
+}
+
+/**
+  * @brief  UART receive complete callback (circular DMA wrap)
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    ESP8266_UART_RxCpltCallback(huart);
+}
+
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,300 @@
+#!/usr/bin/env node
+// Control/status latency: external broker vs embedded broker
+//
+// Runs server.js as a child process and a simulated board made of the
+// ESP8266 simulator (tools/esp8266-sim) plus a scripted stand-in for the
+// STM32 firmware that speaks AT commands to it. A WebSocket client then
+// toggles the LED and times both directions:
+//
+//   down  browser control -> +MQTTSUBRECV seen by the "firmware"
+//   up    AT+MQTTPUB of the status -> led_state received by the browser
+//   rtt   browser control -> led_state received by the browser
+//
+// Modes:
+//   external  server.js and the simulator both use --broker (e.g. mosquitto)
+//   embedded  server.js hosts the broker (MQTT_EMBEDDED=1), the simulator
+//             connects to it directly
+//
+// Usage: node bench/broker-latency.js [--modes embedded,external]
+//                                     [--broker mqtt://localhost:1883]
+//                                     [--commands 200] [--gap 20] [--json results.json]
+//
+// Needs `npm install` here (incl. the optional aedes) and in tools/esp8266-sim.
+
+const net = require('net');
+const fs = require('fs');
+const path = require('path');
+const { spawn } = require('child_process');
+const { PassThrough } = require('stream');
+const { EventEmitter } = require('events');
+const WebSocket = require('ws');
+const { Esp8266Simulator } = require('../../../tools/esp8266-sim/esp8266-sim');
+
+const SERVER = path.join(__dirname, '..', 'server.js');
+const DEVICE_ID = 'bench01';
+const COMMAND_TIMEOUT_MS = 5000;
+
+// ---- Scripted firmware ----------------------------------------------------
+
+// Talks to the simulator the way Core/Src/esp8266.c does: one AT command at
+// a time, "OK" / "ERROR" terminated, MQTT messages arriving as URCs.
+class ScriptedFirmware extends EventEmitter {
+    constructor(toModule, fromModule, deviceId) {
+        super();
+        this.toModule = toModule;
+        this.deviceId = deviceId;
+        this.queue = Promise.resolve();
+        this.pending = null;
+        this.rx = '';
+
+        fromModule.on('data', (chunk) => {
+            this.rx += chunk.toString('latin1');
+            let eol;
+            while ((eol = this.rx.indexOf('\r\n')) >= 0) {
+                const line = this.rx.slice(0, eol);
+                this.rx = this.rx.slice(eol + 2);
+                this.onLine(line);
+            }
+        });
+    }
+
+    onLine(line) {
+        const urc = /^\+MQTTSUBRECV:0,"([^"]*)",(\d+),(.*)$/.exec(line);
+        if (urc) {
+            this.emit('message', urc[1], urc[3]);
+        } else if (this.pending && (line === 'OK' || line === 'ERROR' || line === 'FAIL')) {
+            const { resolve, reject, timer } = this.pending;
+            this.pending = null;
+            clearTimeout(timer);
+            if (line === 'OK') resolve();
+            else reject(new Error(`${line}`));
+        }
+    }
+
+    // Queue an AT command; resolves on OK
+    command(text) {
+        const run = () => new Promise((resolve, reject) => {
+            const timer = setTimeout(() => {
+                this.pending = null;
+                reject(new Error(`timeout: ${text}`));
+            }, COMMAND_TIMEOUT_MS);
+            this.pending = { resolve, reject, timer };
+            this.toModule.write(`${text}\r\n`);
+        });
+        const result = this.queue.then(run);
+        this.queue = result.catch(() => {});
+        return result;
+    }
+
+    async start() {
+        await this.command('ATE0');
+        await this.command('AT+CWMODE=1');
+        await this.command('AT+CWJAP="bench","bench"');
+        await this.command(`AT+MQTTUSERCFG=0,1,"STM32_LED_Controller_${this.deviceId}","","",0,0,""`);
+        await this.command('AT+MQTTCONN=0,"127.0.0.1",1883,1');
+        await this.command(`AT+MQTTSUB=0,"${this.deviceId}/led/control",1`);
+        await this.publishStatus('STM32 Connected - LED: OFF #0');
+    }
+
+    publishStatus(message) {
+        this.emit('publish');
+        return this.command(`AT+MQTTPUB=0,"${this.deviceId}/led/status","${message}",1,0`);
+    }
+}
+
+// ---- Helpers --------------------------------------------------------------
+
+function parseArgs(argv) {
+    const opts = {
+        modes: ['embedded', 'external'],
+        broker: 'mqtt://localhost:1883',
+        commands: 200,
+        gap: 20,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--modes': opts.modes = value.split(','); i++; break;
+            case '--broker': opts.broker = value; i++; break;
+            case '--commands': opts.commands = parseInt(value, 10); i++; break;
+            case '--gap': opts.gap = parseInt(value, 10); i++; break;
+            case '--json': opts.json = value; i++; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+    }
+    return opts;
+}
+
+function freePort() {
+    return new Promise((resolve, reject) => {
+        const probe = net.createServer();
+        probe.once('error', reject);
+        probe.listen(0, '127.0.0.1', () => {
+            const { port } = probe.address();
+            probe.close(() => resolve(port));
+        });
+    });
+}
+
+function startServer(env, readyText) {
+    return new Promise((resolve, reject) => {
+        const child = spawn(process.execPath, [SERVER], {
+            env: Object.assign({}, process.env, env),
+            stdio: ['ignore', 'pipe', 'inherit']
+        });
+        let output = '';
+        const timer = setTimeout(() => reject(new Error('server.js did not start')), 10000);
+        child.stdout.on('data', (chunk) => {
+            if (output !== null) {
+                output += chunk;
+                if (readyText.every((text) => output.includes(text))) {
+                    output = null;
+                    clearTimeout(timer);
+                    resolve(child);
+                }
+            }
+        });
+        child.once('exit', (code) => reject(new Error(`server.js exited with code ${code}`)));
+    });
+}
+
+function summarize(samples) {
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        count: sorted.length,
+        mean: sorted.reduce((a, b) => a + b, 0) / sorted.length,
+        p50: pick(0.5),
+        p95: pick(0.95),
+        max: sorted[sorted.length - 1]
+    };
+}
+
+const now = () => Number(process.hrtime.bigint()) / 1e6;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// ---- One mode -------------------------------------------------------------
+
+async function runMode(mode, opts) {
+    const httpPort = await freePort();
+    let brokerUrl = opts.broker;
+    const env = { PORT: String(httpPort) };
+    const ready = ['Dashboard running'];
+
+    if (mode === 'embedded') {
+        const mqttPort = await freePort();
+        brokerUrl = `mqtt://127.0.0.1:${mqttPort}`;
+        Object.assign(env, { MQTT_EMBEDDED: '1', MQTT_PORT: String(mqttPort) });
+        ready.push('Embedded MQTT broker listening');
+    } else {
+        env.MQTT_BROKER_URL = brokerUrl;
+        ready.push('Connected to MQTT broker');
+    }
+
+    const server = await startServer(env, ready);
+    const toModule = new PassThrough();
+    const fromModule = new PassThrough();
+    const sim = new Esp8266Simulator(toModule, fromModule, {
+        broker: brokerUrl, delay: 0, jitter: 0, bootDelay: 0, wifiDelay: 0
+    });
+    const firmware = new ScriptedFirmware(toModule, fromModule, DEVICE_ID);
+    const ws = new WebSocket(`ws://127.0.0.1:${httpPort}`);
+
+    try {
+        await new Promise((resolve, reject) => {
+            ws.once('open', resolve);
+            ws.once('error', reject);
+        });
+
+        // Device status as seen by the browser
+        let statusWaiter = null;
+        ws.on('message', (raw) => {
+            const data = JSON.parse(raw);
+            if (data.type === 'led_state' && data.device === DEVICE_ID && statusWaiter) {
+                statusWaiter(now());
+            }
+        });
+        const nextStatus = () => new Promise((resolve, reject) => {
+            const timer = setTimeout(() => reject(new Error('timed out waiting for led_state')), COMMAND_TIMEOUT_MS);
+            statusWaiter = (t) => {
+                clearTimeout(timer);
+                statusWaiter = null;
+                resolve(t);
+            };
+        });
+
+        // The "firmware" applies each command ("on#<seq>") and reports the
+        // new state, echoing the sequence number like the real one
+        let controlSeen = 0;
+        let publishStart = 0;
+        firmware.on('message', (topic, data) => {
+            controlSeen = now();
+            const [command, seq = '0'] = data.split('#');
+            firmware.publishStatus(`LED: ${command === 'on' ? 'ON' : 'OFF'} #${seq}`).catch(() => {});
+        });
+        firmware.on('publish', () => {
+            publishStart = now();
+        });
+
+        const boot = nextStatus();
+        await firmware.start();
+        await boot;
+        ws.send(JSON.stringify({ type: 'unsubscribe', devices: ['*'] }));
+        ws.send(JSON.stringify({ type: 'subscribe', devices: [DEVICE_ID] }));
+
+        const down = [];
+        const up = [];
+        const rtt = [];
+        for (let i = 0; i < opts.commands; i++) {
+            const status = nextStatus();
+            const sent = now();
+            ws.send(JSON.stringify({ type: 'control', device: DEVICE_ID, state: i % 2 === 0 ? 'on' : 'off' }));
+            const received = await status;
+
+            down.push(controlSeen - sent);
+            up.push(received - publishStart);
+            rtt.push(received - sent);
+            await sleep(opts.gap);
+        }
+
+        return { mode, down: summarize(down), up: summarize(up), rtt: summarize(rtt) };
+    } finally {
+        ws.terminate();
+        sim.close();
+        server.kill();
+    }
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const results = [];
+
+    console.log(`Broker latency: ${opts.commands} commands, ${opts.gap} ms apart (times in ms)`);
+    console.log('mode       direction    p50     p95     max    mean');
+    for (const mode of opts.modes) {
+        const result = await runMode(mode, opts);
+        results.push(result);
+        for (const direction of ['down', 'up', 'rtt']) {
+            const s = result[direction];
+            console.log(
+                `${mode.padEnd(11)}${direction.padEnd(9)}` +
+                `${s.p50.toFixed(2).padStart(8)}${s.p95.toFixed(2).padStart(8)}` +
+                `${s.max.toFixed(2).padStart(8)}${s.mean.toFixed(2).padStart(8)}`
+            );
+        }
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify(results, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+    process.exit(0);
+}
+
+main().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});
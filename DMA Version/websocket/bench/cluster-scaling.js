@@ -0,0 +1,325 @@
+#!/usr/bin/env node
+// Cluster scaling: connection and broadcast capacity vs WORKERS
+//
+// For every worker count, starts server.js with WORKERS=<n> (1 = the plain
+// single-process server) and measures:
+//
+//   connect   WebSocket connections accepted per second while --clients
+//             browsers connect all at once
+//   broadcast --updates LED statuses published to MQTT back to back (spread
+//             over --devices devices, every browser watching all of them):
+//             updates fanned out per second, frames delivered per second
+//             and MQTT publish -> browser latency
+//   memory    RSS of all server processes together once connected
+//
+// "delivered" below 100% means updates were coalesced for browsers that
+// fell behind (WS_SOFT_LIMIT), i.e. the server was past its capacity.
+//
+// The browsers live in --client-workers forked processes. Run it on a
+// machine with at least as many cores as the largest worker count plus the
+// client processes, or the client side becomes the bottleneck.
+//
+// By default server.js hosts the broker (MQTT_EMBEDDED=1, needs the optional
+// aedes); --broker mqtt://... uses an external one instead.
+//
+// Usage: node bench/cluster-scaling.js [--workers 1,2,4] [--clients 2000]
+//                                      [--updates 2000] [--devices 100]
+//                                      [--client-workers 4] [--broker mqtt://...]
+//                                      [--json results.json]
+
+const net = require('net');
+const fs = require('fs');
+const path = require('path');
+const { spawn, fork } = require('child_process');
+
+const SERVER = path.join(__dirname, '..', 'server.js');
+const DELIVERY_TIMEOUT_MS = 60000;
+
+const deviceId = (i) => `scale${String(i).padStart(4, '0')}`;
+const now = () => Number(process.hrtime.bigint()) / 1e6;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// ---- Browser worker -------------------------------------------------------
+
+// Opens `count` connections at once, then counts led_state frames
+function runClients(opts) {
+    const WebSocket = require('ws');
+    const clients = [];
+    let expected = Infinity;
+    let received = 0;
+    let lastAt = 0;
+    let latencies = [];
+
+    const onMessage = (data) => {
+        const message = JSON.parse(data);
+        if (message.type !== 'led_state' || expected === Infinity) {
+            return;
+        }
+        received++;
+        lastAt = Date.now();
+        latencies.push(lastAt - parseInt(message.state.split('@')[1], 10));
+        if (received === expected) {
+            process.send({ type: 'delivered', received, lastAt, latencies });
+        }
+    };
+
+    const start = now();
+    let settled = 0;
+    let failed = 0;
+    for (let i = 0; i < opts.count; i++) {
+        const ws = new WebSocket(opts.url);
+        ws.on('open', () => {
+            clients.push(ws);
+            if (++settled === opts.count) {
+                process.send({ type: 'connected', open: clients.length, failed, ms: now() - start });
+            }
+        });
+        ws.on('error', () => {
+            failed++;
+            if (++settled === opts.count) {
+                process.send({ type: 'connected', open: clients.length, failed, ms: now() - start });
+            }
+        });
+        ws.on('message', onMessage);
+    }
+
+    process.on('message', (msg) => {
+        if (msg.type === 'expect') {
+            expected = msg.frames;
+            received = 0;
+            latencies = [];
+            process.send({ type: 'expecting' });
+        } else if (msg.type === 'report') {
+            process.send({ type: 'delivered', received, lastAt, latencies });
+        } else if (msg.type === 'stop') {
+            clients.forEach((ws) => ws.terminate());
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Helpers --------------------------------------------------------------
+
+function parseArgs(argv) {
+    const opts = {
+        workers: [1, 2, 4],
+        clients: 2000,
+        updates: 2000,
+        devices: 100,
+        clientWorkers: 4,
+        broker: null,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--workers': opts.workers = value.split(',').map(Number); break;
+            case '--clients': opts.clients = parseInt(value, 10); break;
+            case '--updates': opts.updates = parseInt(value, 10); break;
+            case '--devices': opts.devices = parseInt(value, 10); break;
+            case '--client-workers': opts.clientWorkers = parseInt(value, 10); break;
+            case '--broker': opts.broker = value; break;
+            case '--json': opts.json = value; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+function freePort() {
+    return new Promise((resolve, reject) => {
+        const probe = net.createServer();
+        probe.once('error', reject);
+        probe.listen(0, '127.0.0.1', () => {
+            const { port } = probe.address();
+            probe.close(() => resolve(port));
+        });
+    });
+}
+
+function summarize(samples) {
+    if (samples.length === 0) {
+        return { count: 0, p50: 0, p99: 0, max: 0 };
+    }
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return { count: sorted.length, p50: pick(0.5), p99: pick(0.99), max: sorted[sorted.length - 1] };
+}
+
+function nextMessage(worker, type) {
+    return new Promise((resolve) => {
+        const onMessage = (msg) => {
+            if (msg.type === type) {
+                worker.removeListener('message', onMessage);
+                resolve(msg);
+            }
+        };
+        worker.on('message', onMessage);
+    });
+}
+
+// Prometheus text -> { name: value } (histogram buckets and labels skipped)
+async function scrape(server) {
+    const text = await (await fetch(`${server}/metrics`)).text();
+    const values = {};
+    for (const line of text.split('\n')) {
+        const match = /^([a-z_]+) ([\d.e+-]+)$/.exec(line);
+        if (match) {
+            values[match[1]] = parseFloat(match[2]);
+        }
+    }
+    return values;
+}
+
+async function waitFor(check, timeout, what) {
+    const deadline = Date.now() + timeout;
+    while (Date.now() < deadline) {
+        try {
+            if (await check()) {
+                return;
+            }
+        } catch (error) {
+            // not up yet
+        }
+        await sleep(200);
+    }
+    throw new Error(`timed out waiting for ${what}`);
+}
+
+function shares(total, parts) {
+    return Array.from({ length: parts }, (_, i) => Math.floor(total / parts) + (i < total % parts ? 1 : 0));
+}
+
+function connectMqtt(url) {
+    const mqtt = require('mqtt');
+    const client = mqtt.connect(url, { clientId: `cluster-scaling-${process.pid}` });
+    return new Promise((resolve, reject) => {
+        client.once('connect', () => resolve(client));
+        client.once('error', reject);
+    });
+}
+
+// ---- One worker count -----------------------------------------------------
+
+async function runCount(workers, opts) {
+    const port = await freePort();
+    const env = {
+        PORT: String(port),
+        WORKERS: String(workers),
+        STATE_FILE: '',
+        HISTORY_DIR: '',
+        LOG_LEVEL: 'warn'
+    };
+    let broker = opts.broker;
+    if (!broker) {
+        const mqttPort = await freePort();
+        Object.assign(env, { MQTT_EMBEDDED: '1', MQTT_PORT: String(mqttPort) });
+        broker = `mqtt://127.0.0.1:${mqttPort}`;
+    } else {
+        env.MQTT_BROKER_URL = broker;
+    }
+    const server = spawn(process.execPath, [SERVER], {
+        env: Object.assign({}, process.env, env),
+        stdio: ['ignore', 'ignore', 'inherit']
+    });
+    const url = `http://127.0.0.1:${port}`;
+    try {
+        await waitFor(async () => {
+            const values = await scrape(url);
+            return workers === 1 || values.cluster_workers === workers;
+        }, 15000, `server.js with ${workers} worker(s)`);
+
+        // The devices exist before the browsers connect, so every update is
+        // a plain state change rather than a new-device broadcast
+        const publisher = await connectMqtt(broker);
+        for (let i = 0; i < opts.devices; i++) {
+            publisher.publish(`${deviceId(i)}/led/status`, 'LED: OFF #0');
+        }
+        await waitFor(async () => (await scrape(url)).devices_known >= opts.devices, 10000, 'devices');
+
+        // Connect
+        const holders = shares(opts.clients, opts.clientWorkers).map((count) =>
+            fork(__filename, ['--worker', JSON.stringify({ url: url.replace(/^http/, 'ws'), count })]));
+        const connected = await Promise.all(holders.map((worker) => nextMessage(worker, 'connected')));
+        const open = connected.reduce((sum, r) => sum + r.open, 0);
+        const connectMs = Math.max(...connected.map((r) => r.ms));
+        const memory = await scrape(url);
+
+        // Broadcast
+        await Promise.all(holders.map((worker, i) => {
+            worker.send({ type: 'expect', frames: connected[i].open * opts.updates });
+            return nextMessage(worker, 'expecting');
+        }));
+        const start = Date.now();
+        const done = holders.map((worker) => nextMessage(worker, 'delivered'));
+        for (let i = 0; i < opts.updates; i++) {
+            // The publish time rides in the state text, so latency covers
+            // broker, ingest, IPC and fan-out
+            publisher.publish(`${deviceId(i % opts.devices)}/led/status`, `LED: ${i % 2 ? 'ON' : 'OFF'} @${Date.now()}`);
+        }
+        const delivered = await Promise.all(done.map((promise, i) => {
+            // Ask for what arrived so far if some frames never come
+            const timer = setTimeout(() => holders[i].send({ type: 'report' }), DELIVERY_TIMEOUT_MS);
+            return promise.then((result) => {
+                clearTimeout(timer);
+                return result;
+            });
+        }));
+        const frames = delivered.reduce((sum, r) => sum + r.received, 0);
+        const seconds = (Math.max(...delivered.map((r) => r.lastAt)) - start) / 1000;
+        const latency = summarize([].concat(...delivered.map((r) => r.latencies)));
+
+        holders.forEach((worker) => worker.send({ type: 'stop' }));
+        publisher.end(true);
+
+        return {
+            workers,
+            clients: open,
+            failed: connected.reduce((sum, r) => sum + r.failed, 0),
+            connectionsPerSec: open / (connectMs / 1000),
+            rssBytes: memory.process_resident_memory_bytes,
+            framesExpected: open * opts.updates,
+            frames,
+            updatesPerSec: opts.updates / seconds,
+            framesPerSec: frames / seconds,
+            latencyMs: latency
+        };
+    } finally {
+        server.kill();
+        await new Promise((resolve) => server.once('exit', resolve));
+    }
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const results = [];
+
+    console.log(`${opts.clients} browsers, ${opts.updates} updates over ${opts.devices} devices\n`);
+    console.log('workers  connect/s  updates/s   frames/s  delivered  p50 ms  p99 ms  RSS MB');
+    for (const workers of opts.workers) {
+        const r = await runCount(workers, opts);
+        results.push(r);
+        console.log(`${String(workers).padStart(7)}${r.connectionsPerSec.toFixed(0).padStart(11)}` +
+            `${r.updatesPerSec.toFixed(0).padStart(11)}${r.framesPerSec.toFixed(0).padStart(11)}` +
+            `${(100 * r.frames / r.framesExpected).toFixed(1).padStart(10)}%` +
+            `${r.latencyMs.p50.toFixed(0).padStart(8)}${r.latencyMs.p99.toFixed(0).padStart(8)}` +
+            `${(r.rssBytes / 1048576).toFixed(1).padStart(8)}`);
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify({ options: opts, results }, null, 2));
+        console.log(`\nResults written to ${opts.json}`);
+    }
+}
+
+if (process.argv[2] === '--worker') {
+    runClients(JSON.parse(process.argv[3]));
+} else {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}
@@ -0,0 +1,167 @@
+#!/usr/bin/env node
+// Dashboard frame times under a stream of LED updates
+//
+// Serves the dashboard (public/, or another copy with --public, e.g. an
+// older version exported with `git archive`) together with
+// bench/dashboard-frames.html, and plays the server's part of the
+// WebSocket protocol: a snapshot of --devices devices, then led_state
+// messages at --rate per second spread over those devices. Subscriptions
+// are ignored, so the page receives every update like a dashboard that
+// watches all devices.
+//
+// Open the printed URL in a browser (a real one, with the window visible:
+// hidden tabs get no animation frames). For each pass (normal, and with
+// ?debug logging) the page loads the dashboard in a frame, streams for
+// --seconds and reports frame intervals, long tasks (Chrome) and DOM
+// mutations per second, which are printed here.
+//
+// Usage: node bench/dashboard-frames.js [--rate 1000] [--devices 10]
+//                                       [--seconds 10] [--port 3300]
+//                                       [--public dir] [--json results.json]
+
+const http = require('http');
+const fs = require('fs');
+const path = require('path');
+const WebSocket = require('ws');
+const { StaticAssets } = require('../lib/static-assets');
+
+const PAGE = path.join(__dirname, 'dashboard-frames.html');
+const PASSES = [
+    { name: 'default', query: '' },
+    { name: 'debug log', query: '?debug' }
+];
+const TICK_MS = 4;
+
+const deviceId = (i) => `frame${String(i).padStart(4, '0')}`;
+
+function parseArgs(argv) {
+    const opts = {
+        rate: 1000,
+        devices: 10,
+        seconds: 10,
+        port: 3300,
+        public: path.join(__dirname, '..', 'public'),
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--rate': opts.rate = parseInt(value, 10); break;
+            case '--devices': opts.devices = parseInt(value, 10); break;
+            case '--seconds': opts.seconds = parseInt(value, 10); break;
+            case '--port': opts.port = parseInt(value, 10); break;
+            case '--public': opts.public = path.resolve(value); break;
+            case '--json': opts.json = value; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+// led_state messages at opts.rate per second to every dashboard connected
+function startStream(wss, opts) {
+    const start = Date.now();
+    let sent = 0;
+    const seq = new Array(opts.devices).fill(0);
+    return new Promise((resolve) => {
+        const timer = setInterval(() => {
+            const elapsed = Date.now() - start;
+            const due = Math.min(opts.rate * opts.seconds, Math.floor(opts.rate * elapsed / 1000));
+            for (; sent < due; sent++) {
+                const i = sent % opts.devices;
+                const message = JSON.stringify({
+                    type: 'led_state',
+                    device: deviceId(i),
+                    state: `LED: ${++seq[i] % 2 ? 'ON' : 'OFF'} #${seq[i]}`,
+                    seq: seq[i],
+                    updatedAt: Date.now()
+                });
+                for (const ws of wss.clients) {
+                    ws.send(message);
+                }
+            }
+            if (sent === opts.rate * opts.seconds) {
+                clearInterval(timer);
+                resolve({ sent, ms: Date.now() - start });
+            }
+        }, TICK_MS);
+    });
+}
+
+function readBody(req) {
+    return new Promise((resolve) => {
+        const chunks = [];
+        req.on('data', (chunk) => chunks.push(chunk));
+        req.on('end', () => resolve(Buffer.concat(chunks).toString()));
+    });
+}
+
+function printResult(pass, r) {
+    console.log(`${pass.padEnd(10)}${String(r.frames).padStart(7)}${r.meanMs.toFixed(1).padStart(8)}` +
+        `${r.p95Ms.toFixed(1).padStart(8)}${r.p99Ms.toFixed(1).padStart(8)}${r.maxMs.toFixed(1).padStart(8)}` +
+        `${String(r.slowFrames).padStart(8)}${String(r.longTasks).padStart(7)}${r.longTaskMs.toFixed(0).padStart(8)}` +
+        `${r.mutationsPerSec.toFixed(0).padStart(11)}`);
+}
+
+function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const assets = new StaticAssets(opts.public).load().middleware();
+    const results = [];
+
+    const server = http.createServer(async (req, res) => {
+        const url = new URL(req.url, 'http://localhost');
+        if (url.pathname === '/bench') {
+            res.setHeader('Content-Type', 'text/html; charset=utf-8');
+            res.end(fs.readFileSync(PAGE));
+        } else if (url.pathname === '/bench/config') {
+            res.setHeader('Content-Type', 'application/json');
+            res.end(JSON.stringify({ passes: PASSES, seconds: opts.seconds }));
+        } else if (url.pathname === '/bench/start' && req.method === 'POST') {
+            res.setHeader('Content-Type', 'application/json');
+            res.end(JSON.stringify(await startStream(wss, opts)));
+        } else if (url.pathname === '/bench/result' && req.method === 'POST') {
+            const result = JSON.parse(await readBody(req));
+            results.push(result);
+            printResult(result.pass, result);
+            res.end();
+            if (results.length === PASSES.length) {
+                if (opts.json) {
+                    fs.writeFileSync(opts.json, JSON.stringify({ options: opts, results }, null, 2));
+                    console.log(`\nResults written to ${opts.json}`);
+                }
+                process.exit(0);
+            }
+        } else {
+            assets(req, res, () => {
+                res.statusCode = 404;
+                res.end('not found');
+            });
+        }
+    });
+
+    // The dashboard's half of the server protocol: connection + snapshot
+    const wss = new WebSocket.Server({
+        server,
+        handleProtocols: (offered) => (offered.has('led.v1.json') ? 'led.v1.json' : false)
+    });
+    wss.on('connection', (ws) => {
+        ws.send(JSON.stringify({ type: 'connection', status: 'connected' }));
+        ws.send(JSON.stringify({
+            type: 'snapshot',
+            devices: Array.from({ length: opts.devices }, (_, i) => ({
+                id: deviceId(i), state: 'LED: OFF #0', seq: 0, updatedAt: Date.now()
+            }))
+        }));
+    });
+
+    server.listen(opts.port, () => {
+        console.log(`${opts.rate} updates/s over ${opts.devices} devices for ${opts.seconds} s, dashboard from ${opts.public}`);
+        console.log(`Open http://localhost:${opts.port}/bench in a browser\n`);
+        console.log('pass       frames    mean     p95     p99     max  >33 ms  long  long ms  DOM muts/s');
+    });
+}
+
+main();
@@ -0,0 +1,232 @@
+#!/usr/bin/env node
+// Broadcast fan-out benchmark
+//
+// Measures what one `led/status` broadcast costs the server as the number of
+// connected dashboards grows, comparing the shared-buffer broadcast in
+// lib/broadcast.js with the old stringify-per-client loop.
+//
+// Clients live in forked worker processes so their receive work does not
+// run on the server's event loop.
+//
+// Usage: node bench/fanout.js [--clients 10,100,1000,10000] [--rounds 50]
+//                             [--workers 4] [--json results.json]
+
+const http = require('http');
+const os = require('os');
+const fs = require('fs');
+const { fork } = require('child_process');
+const WebSocket = require('ws');
+const { Broadcaster } = require('../lib/broadcast');
+
+const MESSAGE = { type: 'led_state', device: 'default', state: 'LED: ON' };
+
+// ---- Fan-out strategies under test ----------------------------------------
+
+const strategies = {
+    // What server.js did before: one JSON.stringify per connected client
+    'per-client'(broadcaster) {
+        let sent = 0;
+        broadcaster.clients.forEach((client) => {
+            if (client.readyState === WebSocket.OPEN) {
+                client.send(JSON.stringify(MESSAGE));
+                sent++;
+            }
+        });
+        return sent;
+    },
+
+    'shared'(broadcaster) {
+        return broadcaster.broadcast(MESSAGE, MESSAGE.device);
+    }
+};
+
+// ---- Client worker --------------------------------------------------------
+
+function runWorker(port, count) {
+    const sockets = [];
+    let open = 0;
+    let received = 0;
+    let next = 0;
+    let pending = 0;
+
+    // Open connections a batch at a time so the listen backlog never overflows
+    const connectMore = () => {
+        while (next < count && pending < 200) {
+            const ws = new WebSocket(`ws://127.0.0.1:${port}`);
+            next++;
+            pending++;
+            ws.on('open', () => {
+                pending--;
+                if (++open === count) {
+                    process.send({ type: 'ready' });
+                }
+                connectMore();
+            });
+            ws.on('message', () => {
+                // Each broadcast round delivers exactly one message per socket
+                if (++received % count === 0) {
+                    process.send({ type: 'round' });
+                }
+            });
+            ws.on('error', (error) => {
+                process.send({ type: 'error', message: error.message });
+            });
+            sockets.push(ws);
+        }
+    };
+
+    connectMore();
+    process.on('message', (msg) => {
+        if (msg.type === 'exit') {
+            sockets.forEach((ws) => ws.terminate());
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Server side ----------------------------------------------------------
+
+function parseArgs(argv) {
+    const opts = {
+        clients: [10, 100, 1000, 10000],
+        rounds: 50,
+        warmup: 5,
+        workers: Math.max(1, Math.min(4, os.cpus().length - 1)),
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--clients': opts.clients = value.split(',').map(Number); i++; break;
+            case '--rounds': opts.rounds = parseInt(value, 10); i++; break;
+            case '--warmup': opts.warmup = parseInt(value, 10); i++; break;
+            case '--workers': opts.workers = parseInt(value, 10); i++; break;
+            case '--json': opts.json = value; i++; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+    }
+    return opts;
+}
+
+function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+}
+
+function summarize(samples) {
+    const sorted = samples.slice().sort((a, b) => a - b);
+    return {
+        p50: percentile(sorted, 0.5),
+        p95: percentile(sorted, 0.95),
+        mean: samples.reduce((a, b) => a + b, 0) / samples.length
+    };
+}
+
+function waitFor(workers, type) {
+    return Promise.all(workers.map((worker) => new Promise((resolve, reject) => {
+        const onMessage = (msg) => {
+            if (msg.type === type) {
+                worker.removeListener('message', onMessage);
+                resolve();
+            } else if (msg.type === 'error') {
+                reject(new Error(msg.message));
+            }
+        };
+        worker.on('message', onMessage);
+    })));
+}
+
+async function measure(count, opts) {
+    const server = http.createServer();
+    const wss = new WebSocket.Server({ server, backlog: 1024 });
+    const broadcaster = new Broadcaster();
+
+    wss.on('connection', (ws) => {
+        broadcaster.add(ws);
+        ws.on('close', () => broadcaster.delete(ws));
+    });
+    await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+    const port = server.address().port;
+
+    // Spread the clients over the workers
+    const workerCount = Math.min(opts.workers, count);
+    const workers = [];
+    for (let i = 0; i < workerCount; i++) {
+        const share = Math.floor(count / workerCount) + (i < count % workerCount ? 1 : 0);
+        workers.push(fork(__filename, ['--worker', String(port), String(share)]));
+    }
+    await waitFor(workers, 'ready');
+
+    const result = { clients: count };
+    for (const [name, fanOut] of Object.entries(strategies)) {
+        const send = [];
+        const delivered = [];
+
+        for (let round = 0; round < opts.warmup + opts.rounds; round++) {
+            const done = waitFor(workers, 'round');
+            const start = process.hrtime.bigint();
+            const sent = fanOut(broadcaster);
+            const queued = process.hrtime.bigint();
+            await done;
+            const finished = process.hrtime.bigint();
+
+            if (sent !== count) {
+                throw new Error(`${name}: sent ${sent} of ${count}`);
+            }
+            if (round >= opts.warmup) {
+                send.push(Number(queued - start) / 1e6);
+                delivered.push(Number(finished - start) / 1e6);
+            }
+        }
+
+        result[name] = { send: summarize(send), delivered: summarize(delivered) };
+    }
+
+    workers.forEach((worker) => worker.send({ type: 'exit' }));
+    broadcaster.clients.forEach((ws) => ws.terminate());
+    await new Promise((resolve) => wss.close(resolve));
+    await new Promise((resolve) => server.close(resolve));
+    return result;
+}
+
+function printRow(result) {
+    for (const name of Object.keys(strategies)) {
+        const { send, delivered } = result[name];
+        console.log(
+            `${String(result.clients).padStart(7)}  ${name.padEnd(10)}` +
+            `${send.p50.toFixed(3).padStart(10)} ${send.p95.toFixed(3).padStart(9)}` +
+            `${delivered.p50.toFixed(3).padStart(12)} ${delivered.p95.toFixed(3).padStart(9)}` +
+            `${(send.mean * 1000 / result.clients).toFixed(2).padStart(12)}`
+        );
+    }
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+
+    console.log(`Fan-out benchmark: ${opts.rounds} rounds (+${opts.warmup} warm-up), ${opts.workers} client worker(s)`);
+    console.log('                   send loop (ms)       delivered (ms)     send cost');
+    console.log('clients  strategy      p50       p95        p50       p95   (us/client)');
+
+    const results = [];
+    for (const count of opts.clients) {
+        const result = await measure(count, opts);
+        printRow(result);
+        results.push(result);
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify(results, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+}
+
+if (process.argv[2] === '--worker') {
+    runWorker(parseInt(process.argv[3], 10), parseInt(process.argv[4], 10));
+} else {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}
@@ -0,0 +1,515 @@
+#!/usr/bin/env node
+// Synthetic fleet: capacity test with thousands of boards and browsers
+//
+// Simulated boards are MQTT clients that behave like Core/Src/main.c: they
+// subscribe to "<id>/led/control", "<id>/led/status_request" and the
+// fleet-wide "led/status_request", publish "STM32 Connected - LED: OFF #0"
+// (retained) on connect, answer "on#7" with "LED: ON #7" after
+// --device-delay ms and answer status requests with their current state.
+//
+// Simulated browsers are WebSocket clients of server.js that watch all
+// devices (or --interest random ones) and send LED commands the way
+// public/index.html does. Both run in forked worker processes.
+//
+// The command rate is then stepped through --rates, --phase seconds each.
+// Per step it reports:
+//
+//   cmd/s     commands sent by the browsers
+//   acked     share of commands acknowledged (by the device's status)
+//   latency   browser -> server -> board -> server -> browser ack, ms
+//   frames/s  WebSocket frames received by all browsers together
+//   server    MQTT messages in/s, event loop lag, heap and RSS (/metrics)
+//
+// The throughput ceiling is the highest step that kept p99 at or under
+// --slo-p99 ms with at least --slo-acked of the commands acknowledged;
+// the ramp stops at the first step that misses it.
+//
+// By default server.js is started with its embedded broker (needs the
+// optional aedes) and without state file or history. To test a running
+// deployment instead, pass --server http://host:3000 and --broker.
+//
+// Usage: node bench/fleet.js [--devices 1000] [--clients 1000] [--interest 0]
+//                            [--rates 50,100,200,400,800] [--phase 10]
+//                            [--device-delay 10] [--protocol json|binary]
+//                            [--device-workers 2] [--client-workers 2]
+//                            [--slo-p99 250] [--slo-acked 0.99]
+//                            [--server http://localhost:3000 --broker mqtt://...]
+//                            [--json results.json]
+
+const net = require('net');
+const fs = require('fs');
+const path = require('path');
+const { spawn, fork } = require('child_process');
+
+const SERVER = path.join(__dirname, '..', 'server.js');
+const CONNECT_BATCH = 50;           // connections opened per tick by each worker
+const CONNECT_TICK_MS = 20;
+const REPORT_INTERVAL_MS = 1000;
+
+const deviceId = (i) => `sim${String(i).padStart(5, '0')}`;
+const now = () => Number(process.hrtime.bigint()) / 1e6;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// Open `count` connections a batch at a time so the server is not hit by
+// one huge SYN burst; connect(i) must return a promise
+async function rampUp(count, connect) {
+    const opened = [];
+    for (let i = 0; i < count; i += CONNECT_BATCH) {
+        for (let j = i; j < Math.min(count, i + CONNECT_BATCH); j++) {
+            opened.push(connect(j));
+        }
+        await sleep(CONNECT_TICK_MS);
+    }
+    return Promise.all(opened);
+}
+
+// ---- Board worker ---------------------------------------------------------
+
+function runDevices(opts) {
+    const mqtt = require('mqtt');
+
+    const startDevice = (i) => new Promise((resolve) => {
+        const id = deviceId(opts.first + i);
+        const state = { on: false, seq: 0 };
+        const client = mqtt.connect(opts.broker, { clientId: id, keepalive: 60, reconnectPeriod: 1000 });
+        const publish = (text) => {
+            client.publish(`${id}/led/status`, `${text} #${state.seq}`, { qos: 1, retain: true });
+        };
+        const led = () => (state.on ? 'ON' : 'OFF');
+
+        client.on('connect', () => {
+            client.subscribe([`${id}/led/control`, `${id}/led/status_request`, 'led/status_request'], { qos: 1 }, () => {
+                publish(`STM32 Connected - LED: ${led()}`);
+                resolve();
+            });
+        });
+        client.on('message', (topic, message) => {
+            if (topic.endsWith('/led/control')) {
+                // "on#42": the sequence number is echoed in the status
+                const [command, seq] = message.toString().split('#');
+                const value = command.toLowerCase();
+                if (value !== 'on' && value !== '1' && value !== 'off' && value !== '0') {
+                    return;
+                }
+                setTimeout(() => {
+                    state.on = value === 'on' || value === '1';
+                    state.seq = seq ? parseInt(seq, 10) : 0;
+                    publish(`LED: ${led()}`);
+                }, opts.delay);
+            } else {
+                publish(`LED: ${led()}`);
+            }
+        });
+        client.on('error', () => {});
+    });
+
+    rampUp(opts.count, startDevice).then(() => process.send({ type: 'ready' }));
+    process.on('message', (msg) => {
+        if (msg.type === 'stop') {
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Browser worker -------------------------------------------------------
+
+function runClients(opts) {
+    const WebSocket = require('ws');
+    const protocol = require('../public/protocol');
+    const { ALL_DEVICES } = require('../lib/broadcast');
+    const clients = [];
+    const outstanding = new Map();      // command id -> send time
+    let phase = null;
+    let nextId = 0;
+    let failed = 0;
+
+    const onMessage = (data, isBinary) => {
+        if (phase) {
+            phase.frames++;
+        }
+        let message;
+        try {
+            message = isBinary ? protocol.decode(data) : JSON.parse(data);
+        } catch (error) {
+            return;
+        }
+        if ((message.type === 'ack' || message.type === 'nack') && outstanding.has(message.id)) {
+            const sentAt = outstanding.get(message.id);
+            outstanding.delete(message.id);
+            if (!phase) {
+                return;
+            }
+            if (message.type === 'ack') {
+                phase.latencies.push(now() - sentAt);
+            } else {
+                phase.nacks[message.reason] = (phase.nacks[message.reason] || 0) + 1;
+            }
+        }
+    };
+
+    const connect = () => new Promise((resolve) => {
+        const ws = new WebSocket(opts.url, opts.protocol === 'binary' ? [protocol.BINARY_PROTOCOL] : []);
+        if (opts.protocol === 'binary') {
+            ws.binaryType = 'nodebuffer';
+        }
+        ws.on('open', () => {
+            if (opts.interest > 0) {
+                // New clients watch every device until they opt out
+                ws.send(JSON.stringify({ type: 'unsubscribe', devices: [ALL_DEVICES] }));
+                const ids = [];
+                for (let i = 0; i < opts.interest; i++) {
+                    ids.push(deviceId(Math.floor(Math.random() * opts.devices)));
+                }
+                ws.send(JSON.stringify({ type: 'subscribe', devices: ids }));
+            }
+            clients.push(ws);
+            resolve();
+        });
+        ws.on('message', onMessage);
+        ws.on('error', () => {
+            failed++;
+            resolve();
+        });
+    });
+
+    // Spread `rate` commands per second over the open clients
+    const runPhase = async (rate, duration, drain) => {
+        phase = { sent: 0, frames: 0, latencies: [], nacks: {} };
+        const start = now();
+        let next = 0;
+        while (now() - start < duration * 1000) {
+            const due = Math.floor((now() - start) / 1000 * rate);
+            for (; phase.sent < due && clients.length > 0; phase.sent++) {
+                const ws = clients[next++ % clients.length];
+                const id = `${process.pid}-${++nextId}`;
+                outstanding.set(id, now());
+                ws.send(JSON.stringify({
+                    type: 'control',
+                    id,
+                    device: deviceId(Math.floor(Math.random() * opts.devices)),
+                    state: Math.random() < 0.5 ? 'on' : 'off'
+                }));
+            }
+            await sleep(5);
+        }
+        // Wait for the stragglers (retries included), then count the rest as lost
+        const drainUntil = now() + drain;
+        while (outstanding.size > 0 && now() < drainUntil) {
+            await sleep(20);
+        }
+        const result = Object.assign({ lost: outstanding.size }, phase);
+        outstanding.clear();
+        phase = null;
+        return result;
+    };
+
+    rampUp(opts.count, connect).then(() => process.send({ type: 'ready', open: clients.length, failed }));
+    process.on('message', async (msg) => {
+        if (msg.type === 'phase') {
+            const result = await runPhase(msg.rate, msg.duration, msg.drain);
+            process.send(Object.assign({ type: 'phase', open: clients.filter((ws) => ws.readyState === WebSocket.OPEN).length }, result));
+        } else if (msg.type === 'stop') {
+            clients.forEach((ws) => ws.terminate());
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Helpers --------------------------------------------------------------
+
+function parseArgs(argv) {
+    const opts = {
+        devices: 1000,
+        clients: 1000,
+        interest: 0,
+        rates: [50, 100, 200, 400, 800],
+        phase: 10,
+        drain: 7000,        // command timeout x (retries + 1), plus margin
+        deviceDelay: 10,
+        protocol: 'json',
+        deviceWorkers: 2,
+        clientWorkers: 2,
+        sloP99: 250,
+        sloAcked: 0.99,
+        server: null,
+        broker: null,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--devices': opts.devices = parseInt(value, 10); break;
+            case '--clients': opts.clients = parseInt(value, 10); break;
+            case '--interest': opts.interest = parseInt(value, 10); break;
+            case '--rates': opts.rates = value.split(',').map(Number); break;
+            case '--phase': opts.phase = parseFloat(value); break;
+            case '--drain': opts.drain = parseInt(value, 10); break;
+            case '--device-delay': opts.deviceDelay = parseInt(value, 10); break;
+            case '--protocol': opts.protocol = value; break;
+            case '--device-workers': opts.deviceWorkers = parseInt(value, 10); break;
+            case '--client-workers': opts.clientWorkers = parseInt(value, 10); break;
+            case '--slo-p99': opts.sloP99 = parseFloat(value); break;
+            case '--slo-acked': opts.sloAcked = parseFloat(value); break;
+            case '--server': opts.server = value.replace(/\/$/, ''); break;
+            case '--broker': opts.broker = value; break;
+            case '--json': opts.json = value; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    if (opts.server && !opts.broker) {
+        console.error('--server needs --broker (the broker that server uses)');
+        process.exit(1);
+    }
+    return opts;
+}
+
+function freePort() {
+    return new Promise((resolve, reject) => {
+        const probe = net.createServer();
+        probe.once('error', reject);
+        probe.listen(0, '127.0.0.1', () => {
+            const { port } = probe.address();
+            probe.close(() => resolve(port));
+        });
+    });
+}
+
+function summarize(samples) {
+    if (samples.length === 0) {
+        return { count: 0, mean: 0, p50: 0, p90: 0, p99: 0, p999: 0, max: 0 };
+    }
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        count: sorted.length,
+        mean: sorted.reduce((a, b) => a + b, 0) / sorted.length,
+        p50: pick(0.5),
+        p90: pick(0.9),
+        p99: pick(0.99),
+        p999: pick(0.999),
+        max: sorted[sorted.length - 1]
+    };
+}
+
+function request(worker, type, extra = {}) {
+    return new Promise((resolve) => {
+        const onMessage = (msg) => {
+            if (msg.type === type) {
+                worker.removeListener('message', onMessage);
+                resolve(msg);
+            }
+        };
+        worker.on('message', onMessage);
+        if (type !== 'ready') {
+            worker.send(Object.assign({ type }, extra));
+        }
+    });
+}
+
+// Prometheus text -> { name: value } (histogram buckets and labels skipped)
+async function scrape(server) {
+    const text = await (await fetch(`${server}/metrics`)).text();
+    const values = {};
+    for (const line of text.split('\n')) {
+        const match = /^([a-z_]+) ([\d.e+-]+)$/.exec(line);
+        if (match) {
+            values[match[1]] = parseFloat(match[2]);
+        }
+    }
+    return values;
+}
+
+async function waitFor(check, timeout, what) {
+    const deadline = Date.now() + timeout;
+    while (Date.now() < deadline) {
+        try {
+            if (await check()) {
+                return;
+            }
+        } catch (error) {
+            // not up yet
+        }
+        await sleep(200);
+    }
+    throw new Error(`timed out waiting for ${what}`);
+}
+
+async function startServer(opts) {
+    const port = await freePort();
+    const mqttPort = await freePort();
+    const child = spawn(process.execPath, [SERVER], {
+        env: Object.assign({}, process.env, {
+            PORT: String(port),
+            MQTT_EMBEDDED: '1',
+            MQTT_PORT: String(mqttPort),
+            STATE_FILE: '',
+            HISTORY_DIR: '',
+            LOG_LEVEL: 'warn'
+        }),
+        stdio: ['ignore', 'ignore', 'inherit']
+    });
+    child.once('exit', (code) => {
+        if (code !== null && code !== 0) {
+            console.error(`server.js exited with code ${code}`);
+            process.exit(1);
+        }
+    });
+    opts.server = `http://127.0.0.1:${port}`;
+    opts.broker = `mqtt://127.0.0.1:${mqttPort}`;
+    await waitFor(() => scrape(opts.server), 15000, 'server.js');
+    return child;
+}
+
+// Split `total` into `parts` near-equal shares
+function shares(total, parts) {
+    return Array.from({ length: parts }, (_, i) => Math.floor(total / parts) + (i < total % parts ? 1 : 0));
+}
+
+// ---- Main -----------------------------------------------------------------
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const server = opts.server ? null : await startServer(opts);
+    const workers = [];
+    const mb = (bytes) => (bytes / 1048576).toFixed(1);
+
+    const baseline = await scrape(opts.server);
+    console.log(`Server ${opts.server}, broker ${opts.broker}: heap ${mb(baseline.process_heap_used_bytes)} MB, ` +
+        `RSS ${mb(baseline.process_resident_memory_bytes)} MB`);
+
+    // Boards first, so the browsers' snapshots already list them
+    let first = 0;
+    const boards = shares(opts.devices, opts.deviceWorkers).map((count) => {
+        const worker = fork(__filename, ['--worker', 'devices', JSON.stringify({
+            broker: opts.broker, first, count, delay: opts.deviceDelay
+        })]);
+        first += count;
+        workers.push(worker);
+        return worker;
+    });
+    let start = now();
+    await Promise.all(boards.map((worker) => request(worker, 'ready')));
+    await waitFor(async () => (await scrape(opts.server)).devices_known >= opts.devices, 30000, 'all devices to be known');
+    console.log(`${opts.devices} boards connected in ${((now() - start) / 1000).toFixed(1)} s`);
+
+    const browsers = shares(opts.clients, opts.clientWorkers).map((count) => {
+        const worker = fork(__filename, ['--worker', 'clients', JSON.stringify({
+            url: opts.server.replace(/^http/, 'ws'), count, devices: opts.devices,
+            interest: opts.interest, protocol: opts.protocol
+        })]);
+        workers.push(worker);
+        return worker;
+    });
+    start = now();
+    const ready = await Promise.all(browsers.map((worker) => request(worker, 'ready')));
+    const open = ready.reduce((sum, r) => sum + r.open, 0);
+    const connected = await scrape(opts.server);
+    // Only meaningful for a fresh server, which also hosts the boards' broker sessions
+    const perConnection = server
+        ? ` (~${((connected.process_resident_memory_bytes - baseline.process_resident_memory_bytes) /
+            (open + opts.devices) / 1024).toFixed(1)} KB per connection)`
+        : '';
+    console.log(`${open} browsers connected in ${((now() - start) / 1000).toFixed(1)} s ` +
+        `(${ready.reduce((sum, r) => sum + r.failed, 0)} failed); server heap ${mb(connected.process_heap_used_bytes)} MB, ` +
+        `RSS ${mb(connected.process_resident_memory_bytes)} MB${perConnection}`);
+
+    console.log('\n cmd/s   sent  acked%   p50 ms   p90 ms   p99 ms  p99.9 ms  frames/s  mqtt in/s  lag ms  heap MB  RSS MB');
+    const results = [];
+    let ceiling = null;
+
+    for (const rate of opts.rates) {
+        const before = await scrape(opts.server);
+        let peak = before;
+        const sampler = setInterval(async () => {
+            const sample = await scrape(opts.server).catch(() => null);
+            if (sample && sample.process_resident_memory_bytes > peak.process_resident_memory_bytes) {
+                peak = sample;
+            }
+        }, REPORT_INTERVAL_MS);
+
+        const phaseStart = now();
+        const perWorker = await Promise.all(browsers.map((worker, i) =>
+            request(worker, 'phase', { rate: rate * shares(opts.clients, opts.clientWorkers)[i] / opts.clients, duration: opts.phase, drain: opts.drain })));
+        const seconds = opts.phase;
+        clearInterval(sampler);
+        const after = await scrape(opts.server);
+
+        const sent = perWorker.reduce((sum, r) => sum + r.sent, 0);
+        const latency = summarize([].concat(...perWorker.map((r) => r.latencies)));
+        const nacks = {};
+        perWorker.forEach((r) => Object.entries(r.nacks).forEach(([reason, n]) => {
+            nacks[reason] = (nacks[reason] || 0) + n;
+        }));
+        // Superseded commands were replaced by a newer one to the same device
+        const counted = sent - (nacks.superseded || 0);
+        const acked = counted > 0 ? latency.count / counted : 0;
+        const lagCount = after.eventloop_lag_ms_count - before.eventloop_lag_ms_count;
+        const lag = lagCount > 0 ? (after.eventloop_lag_ms_sum - before.eventloop_lag_ms_sum) / lagCount : 0;
+        const result = {
+            rate,
+            sent,
+            commandsPerSec: sent / seconds,
+            acked,
+            nacks,
+            lost: perWorker.reduce((sum, r) => sum + r.lost, 0),
+            latencyMs: latency,
+            framesPerSec: perWorker.reduce((sum, r) => sum + r.frames, 0) / ((now() - phaseStart) / 1000),
+            mqttInPerSec: (after.mqtt_messages_received_total - before.mqtt_messages_received_total) / ((now() - phaseStart) / 1000),
+            eventLoopLagMs: lag,
+            heapBytes: after.process_heap_used_bytes,
+            peakRssBytes: Math.max(peak.process_resident_memory_bytes, after.process_resident_memory_bytes),
+            browsersOpen: perWorker.reduce((sum, r) => sum + r.open, 0)
+        };
+        results.push(result);
+
+        console.log(`${String(rate).padStart(6)}${String(sent).padStart(7)}${(acked * 100).toFixed(1).padStart(8)}` +
+            `${latency.p50.toFixed(1).padStart(9)}${latency.p90.toFixed(1).padStart(9)}${latency.p99.toFixed(1).padStart(9)}` +
+            `${latency.p999.toFixed(1).padStart(10)}${result.framesPerSec.toFixed(0).padStart(10)}${result.mqttInPerSec.toFixed(0).padStart(11)}` +
+            `${lag.toFixed(1).padStart(8)}${mb(result.heapBytes).padStart(9)}${mb(result.peakRssBytes).padStart(8)}`);
+
+        if (latency.p99 > opts.sloP99 || acked < opts.sloAcked) {
+            console.log(`        missed the target (p99 <= ${opts.sloP99} ms, >= ${(opts.sloAcked * 100).toFixed(1)}% acked)` +
+                (Object.keys(nacks).length ? `; nacks: ${JSON.stringify(nacks)}` : ''));
+            break;
+        }
+        ceiling = result;
+    }
+
+    console.log(ceiling
+        ? `\nThroughput ceiling: ${ceiling.commandsPerSec.toFixed(0)} commands/s with ${opts.devices} boards and ` +
+            `${open} browsers (p99 ${ceiling.latencyMs.p99.toFixed(1)} ms)`
+        : '\nNo step met the target; lower --rates or relax --slo-p99');
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify({
+            options: opts,
+            baseline: { heapBytes: baseline.process_heap_used_bytes, rssBytes: baseline.process_resident_memory_bytes },
+            connected: { browsers: open, heapBytes: connected.process_heap_used_bytes, rssBytes: connected.process_resident_memory_bytes },
+            phases: results,
+            ceiling: ceiling ? ceiling.commandsPerSec : null
+        }, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+
+    workers.forEach((worker) => worker.send({ type: 'stop' }));
+    if (server) {
+        server.kill();
+    }
+}
+
+if (process.argv[2] === '--worker') {
+    const opts = JSON.parse(process.argv[4]);
+    if (process.argv[3] === 'devices') {
+        runDevices(opts);
+    } else {
+        runClients(opts);
+    }
+} else {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}
@@ -0,0 +1,245 @@
+#!/usr/bin/env node
+// Heartbeat soak test
+//
+// Keeps a population of WebSocket clients connected while replacing a few of
+// them every second. Most replaced clients close normally; a fraction go
+// half-open instead, like a phone that fell asleep: their socket stops
+// reading (so they never answer a ping) but is never closed. LED updates are
+// fanned out to every client throughout.
+//
+// Each mode runs against a fresh server built from the same modules as
+// server.js (Broadcaster + Heartbeat):
+//
+//   heartbeat  ping every --interval ms, reap clients that miss a pong
+//   none       no heartbeat, clients are only removed on 'close'
+//
+// Reported per mode: clients tracked by the server vs clients actually
+// alive, dead clients reaped, and heap / RSS per connection at the end.
+//
+// Usage: node bench/heartbeat-soak.js [--modes heartbeat,none] [--duration 30]
+//                                     [--clients 500] [--churn 50] [--dead 0.2]
+//                                     [--interval 1000] [--json results.json]
+
+const http = require('http');
+const fs = require('fs');
+const { fork, spawnSync } = require('child_process');
+const WebSocket = require('ws');
+const { Broadcaster } = require('../lib/broadcast');
+const { Heartbeat } = require('../lib/heartbeat');
+
+const UPDATE_INTERVAL_MS = 100;
+
+// ---- Client worker --------------------------------------------------------
+
+// Keeps `opts.clients` live connections and replaces `opts.churn` of them per
+// second; a fraction `opts.dead` of the replaced ones go half-open
+function runWorker(port, opts) {
+    const live = new Set();
+    const halfOpen = [];
+    let opened = 0;
+
+    const connect = () => {
+        const ws = new WebSocket(`ws://127.0.0.1:${port}`);
+        ws.on('open', () => {
+            live.add(ws);
+            if (++opened === opts.clients) {
+                process.send({ type: 'ready' });
+            }
+        });
+        ws.on('close', () => live.delete(ws));
+        ws.on('error', () => {});
+    };
+
+    for (let i = 0; i < opts.clients; i++) {
+        connect();
+    }
+
+    let churnTimer = null;
+    const churn = () => {
+        const sockets = Array.from(live);
+        for (let i = 0; i < Math.min(opts.churn / 10, sockets.length); i++) {
+            const ws = sockets[Math.floor(Math.random() * sockets.length)];
+            if (!live.delete(ws)) {
+                continue;
+            }
+            if (Math.random() < opts.dead) {
+                // Stop reading: pings go unanswered, nothing is ever closed
+                ws._socket.pause();
+                ws.removeAllListeners('close');
+                halfOpen.push(ws);
+            } else {
+                ws.close();
+            }
+            connect();
+        }
+    };
+
+    process.on('message', (msg) => {
+        if (msg.type === 'churn') {
+            churnTimer = setInterval(churn, 100);
+        } else if (msg.type === 'count') {
+            process.send({ type: 'count', live: live.size, halfOpen: halfOpen.length });
+        } else if (msg.type === 'exit') {
+            clearInterval(churnTimer);
+            live.forEach((ws) => ws.terminate());
+            halfOpen.forEach((ws) => ws._socket.destroy());
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Server side ----------------------------------------------------------
+
+function parseArgs(argv) {
+    const opts = {
+        modes: ['heartbeat', 'none'],
+        duration: 30,
+        clients: 500,
+        churn: 50,
+        dead: 0.2,
+        interval: 1000,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        const key = argv[i].replace(/^--/, '');
+        if (key === 'json') {
+            opts.json = value;
+        } else if (key === 'modes') {
+            opts.modes = value.split(',');
+        } else if (key in opts) {
+            opts[key] = parseFloat(value);
+        } else {
+            console.error(`Unknown option: ${argv[i]}`);
+            process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+function request(worker, type) {
+    return new Promise((resolve) => {
+        const onMessage = (msg) => {
+            if (msg.type === type) {
+                worker.removeListener('message', onMessage);
+                resolve(msg);
+            }
+        };
+        worker.on('message', onMessage);
+        if (type !== 'ready') {
+            worker.send({ type });
+        }
+    });
+}
+
+function memory() {
+    global.gc();
+    global.gc();
+    const { heapUsed, rss } = process.memoryUsage();
+    return { heapUsed, rss };
+}
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+async function runMode(mode, opts) {
+    const server = http.createServer();
+    const wss = new WebSocket.Server({ server, backlog: 1024 });
+    const broadcaster = new Broadcaster();
+    const heartbeat = new Heartbeat(broadcaster.clients, {
+        interval: opts.interval,
+        onReap: (ws) => broadcaster.delete(ws)
+    });
+
+    wss.on('connection', (ws) => {
+        broadcaster.add(ws);
+        heartbeat.watch(ws);
+        ws.on('close', () => broadcaster.delete(ws));
+    });
+    await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+    const baseline = memory();
+
+    const worker = fork(__filename, ['--worker', String(server.address().port), JSON.stringify(opts)]);
+    await request(worker, 'ready');
+    if (mode === 'heartbeat') {
+        heartbeat.start();
+    }
+
+    // Status traffic to every client for the whole run
+    let state = false;
+    const updates = setInterval(() => {
+        state = !state;
+        broadcaster.publish('soak', { type: 'led_state', device: 'soak', state: state ? 'LED: ON' : 'LED: OFF' });
+    }, UPDATE_INTERVAL_MS);
+
+    worker.send({ type: 'churn' });
+    const samples = [];
+    for (let t = 1; t <= opts.duration; t++) {
+        await sleep(1000);
+        const counts = await request(worker, 'count');
+        samples.push({ t, tracked: broadcaster.size, live: counts.live, halfOpen: counts.halfOpen, reaped: heartbeat.stats.reaped });
+        process.stdout.write(`\r${mode}: ${t}/${opts.duration} s, tracked ${broadcaster.size}, live ${counts.live}, reaped ${heartbeat.stats.reaped}   `);
+    }
+    process.stdout.write('\n');
+
+    clearInterval(updates);
+    const end = memory();
+    const last = samples[samples.length - 1];
+    const result = {
+        mode,
+        tracked: last.tracked,
+        live: last.live,
+        stale: last.tracked - last.live,
+        halfOpen: last.halfOpen,
+        reaped: heartbeat.stats.reaped,
+        heapPerConnection: (end.heapUsed - baseline.heapUsed) / last.tracked,
+        rssPerConnection: (end.rss - baseline.rss) / last.tracked,
+        samples
+    };
+
+    heartbeat.stop();
+    worker.send({ type: 'exit' });
+    broadcaster.clients.forEach((ws) => ws.terminate());
+    wss.close();
+    server.close();
+    await sleep(500);
+    return result;
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    console.log(`Heartbeat soak: ${opts.clients} clients, ${opts.churn} replaced/s (${opts.dead * 100}% half-open), ` +
+        `${opts.duration} s, ping every ${opts.interval} ms`);
+
+    const results = [];
+    for (const mode of opts.modes) {
+        results.push(await runMode(mode, opts));
+    }
+
+    console.log('mode        tracked   live  stale  half-open  reaped  heap/conn  rss/conn');
+    for (const r of results) {
+        console.log(
+            `${r.mode.padEnd(10)}${String(r.tracked).padStart(9)}${String(r.live).padStart(7)}` +
+            `${String(r.stale).padStart(7)}${String(r.halfOpen).padStart(11)}${String(r.reaped).padStart(8)}` +
+            `${(r.heapPerConnection / 1024).toFixed(1).padStart(9)}K${(r.rssPerConnection / 1024).toFixed(1).padStart(9)}K`
+        );
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify(results, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+}
+
+if (process.argv[2] === '--worker') {
+    runWorker(parseInt(process.argv[3], 10), JSON.parse(process.argv[4]));
+} else if (!global.gc) {
+    // Memory figures need a forced GC
+    const run = spawnSync(process.execPath, ['--expose-gc', __filename, ...process.argv.slice(2)], { stdio: 'inherit' });
+    process.exit(run.status);
+} else {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}
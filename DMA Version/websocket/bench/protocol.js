@@ -0,0 +1,126 @@
+#!/usr/bin/env node
+// JSON vs binary LED protocol: encode / decode cost and frame size
+//
+// Times the work done per LED update on each side of the socket:
+//
+//   server encode  JSON.stringify + Buffer   vs  protocol.encodeMessage
+//   client decode  JSON.parse of the text    vs  protocol.decode
+//
+// The same file runs in the browser: bench/protocol.html loads it together
+// with public/protocol.js and prints the table on the page.
+//
+// Usage: node bench/protocol.js [--updates 1000000] [--devices 1000] [--json results.json]
+
+(function (root) {
+    const isNode = typeof module === 'object' && module.exports;
+    const P = isNode ? require('../public/protocol') : root.LedProtocol;
+    const now = isNode
+        ? () => Number(process.hrtime.bigint()) / 1e6
+        : () => performance.now();
+
+    function makeUpdates(opts) {
+        const updates = [];
+        const start = Date.now();
+        for (let i = 0; i < Math.min(opts.updates, 10000); i++) {
+            // 24-character IDs like the ones the firmware derives from the UID
+            const id = (0x3F002500 + (i % opts.devices)).toString(16).toUpperCase().padStart(24, '0');
+            updates.push({
+                type: 'led_state',
+                device: id,
+                state: i % 2 ? 'LED: ON' : 'LED: OFF',
+                seq: i + 1,
+                updatedAt: start + i
+            });
+        }
+        return updates;
+    }
+
+    // Runs fn over the updates (cycling) `count` times; returns ns per call
+    function time(count, items, fn) {
+        let sink = 0;
+        const start = now();
+        for (let i = 0; i < count; i++) {
+            sink += fn(items[i % items.length]) ? 1 : 0;
+        }
+        const ms = now() - start;
+        if (sink < 0) {
+            console.log(sink);
+        }
+        return (ms * 1e6) / count;
+    }
+
+    function run(opts, print) {
+        const updates = makeUpdates(opts);
+        const encoder = isNode ? null : new TextEncoder();
+        const jsonEncode = isNode
+            ? (m) => Buffer.from(JSON.stringify(m))
+            : (m) => encoder.encode(JSON.stringify(m));
+        const jsonFrames = updates.map((m) => JSON.stringify(m));
+        const binaryFrames = updates.map((m) => P.encodeMessage(m));
+
+        // Warm up the JIT before measuring
+        time(Math.min(opts.updates, 100000), updates, jsonEncode);
+        time(Math.min(opts.updates, 100000), updates, P.encodeMessage);
+        time(Math.min(opts.updates, 100000), jsonFrames, JSON.parse);
+        time(Math.min(opts.updates, 100000), binaryFrames, P.decode);
+
+        const results = {
+            options: opts,
+            json: {
+                bytes: jsonEncode(updates[0]).length,
+                encodeNs: time(opts.updates, updates, jsonEncode),
+                decodeNs: time(opts.updates, jsonFrames, JSON.parse)
+            },
+            binary: {
+                bytes: binaryFrames[0].length,
+                encodeNs: time(opts.updates, updates, P.encodeMessage),
+                decodeNs: time(opts.updates, binaryFrames, P.decode)
+            }
+        };
+
+        print(`LED protocol benchmark (${isNode ? 'node ' + process.version : navigator.userAgent}): ${opts.updates} updates`);
+        print('format    bytes   encode (ns)  decode (ns)   encode/s    decode/s');
+        for (const name of ['json', 'binary']) {
+            const r = results[name];
+            print(
+                `${name.padEnd(8)}${String(r.bytes).padStart(7)}${r.encodeNs.toFixed(0).padStart(13)}` +
+                `${r.decodeNs.toFixed(0).padStart(13)}${(1e9 / r.encodeNs).toExponential(2).padStart(11)}` +
+                `${(1e9 / r.decodeNs).toExponential(2).padStart(12)}`
+            );
+        }
+        return results;
+    }
+
+    if (!isNode) {
+        root.protocolBench = run;
+        return;
+    }
+
+    function parseArgs(argv) {
+        const opts = { updates: 1000000, devices: 1000, json: null };
+        for (let i = 0; i < argv.length; i++) {
+            const value = argv[i + 1];
+            const key = argv[i].replace(/^--/, '');
+            if (key === 'json') {
+                opts.json = value;
+            } else if (key in opts) {
+                opts[key] = parseInt(value, 10);
+            } else {
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+            }
+            i++;
+        }
+        return opts;
+    }
+
+    if (require.main === module) {
+        const opts = parseArgs(process.argv.slice(2));
+        const results = run(opts, console.log);
+        if (opts.json) {
+            require('fs').writeFileSync(opts.json, JSON.stringify(results, null, 2));
+            console.log(`Results written to ${opts.json}`);
+        }
+    }
+    module.exports = { run };
+}(typeof self !== 'undefined' ? self : this));
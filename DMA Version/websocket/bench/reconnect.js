@@ -0,0 +1,276 @@
+#!/usr/bin/env node
+// Dashboard recovery after a server restart
+//
+// Connects --clients dashboards (the page's own public/reconnect.js, on top
+// of the ws package) to server.js, restarts the server with --downtime ms
+// between stop and start, and measures per client:
+//
+//   recovered   server listening again -> full snapshot received on the new
+//               connection (time-to-recovered)
+//   outage      server stopped -> snapshot received
+//
+// plus the failed connection attempts made while the server was down and
+// the peak number of reconnects within any 100 ms, i.e. how hard the
+// returning clients hit the fresh server. Every client must get exactly one
+// snapshot per connection, holding all --devices devices (restored from the
+// state file), to count as resynced.
+//
+// Runs once per --modes entry: "jitter" is the dashboard's behaviour,
+// "fixed" the same exponential backoff without the random part, for
+// comparison.
+//
+// By default server.js hosts the broker (MQTT_EMBEDDED=1, needs the optional
+// aedes); --broker mqtt://... uses an external one instead.
+//
+// Usage: node bench/reconnect.js [--clients 500] [--devices 20]
+//                                [--downtime 2000] [--modes jitter,fixed]
+//                                [--base-delay 500] [--max-delay 10000]
+//                                [--broker mqtt://...] [--json results.json]
+
+const net = require('net');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { spawn } = require('child_process');
+const WebSocket = require('ws');
+const ReconnectingSocket = require('../public/reconnect');
+
+const SERVER = path.join(__dirname, '..', 'server.js');
+const RECOVERY_TIMEOUT_MS = 120000;
+
+const deviceId = (i) => `recon${String(i).padStart(4, '0')}`;
+const now = () => Number(process.hrtime.bigint()) / 1e6;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+function parseArgs(argv) {
+    const opts = {
+        clients: 500,
+        devices: 20,
+        downtime: 2000,
+        modes: ['jitter', 'fixed'],
+        baseDelay: 500,
+        maxDelay: 10000,
+        broker: null,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--clients': opts.clients = parseInt(value, 10); break;
+            case '--devices': opts.devices = parseInt(value, 10); break;
+            case '--downtime': opts.downtime = parseInt(value, 10); break;
+            case '--modes': opts.modes = value.split(','); break;
+            case '--base-delay': opts.baseDelay = parseInt(value, 10); break;
+            case '--max-delay': opts.maxDelay = parseInt(value, 10); break;
+            case '--broker': opts.broker = value; break;
+            case '--json': opts.json = value; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+function freePort() {
+    return new Promise((resolve, reject) => {
+        const probe = net.createServer();
+        probe.once('error', reject);
+        probe.listen(0, '127.0.0.1', () => {
+            const { port } = probe.address();
+            probe.close(() => resolve(port));
+        });
+    });
+}
+
+function summarize(samples) {
+    if (samples.length === 0) {
+        return { count: 0, p50: 0, p99: 0, max: 0 };
+    }
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return { count: sorted.length, p50: pick(0.5), p99: pick(0.99), max: sorted[sorted.length - 1] };
+}
+
+async function waitFor(check, timeout, what) {
+    const deadline = Date.now() + timeout;
+    while (Date.now() < deadline) {
+        try {
+            if (await check()) {
+                return;
+            }
+        } catch (error) {
+            // not up yet
+        }
+        await sleep(20);
+    }
+    throw new Error(`timed out waiting for ${what}`);
+}
+
+function listening(port) {
+    return new Promise((resolve) => {
+        const socket = net.connect(port, '127.0.0.1');
+        socket.once('connect', () => {
+            socket.destroy();
+            resolve(true);
+        });
+        socket.once('error', () => resolve(false));
+    });
+}
+
+function connectMqtt(url) {
+    const mqtt = require('mqtt');
+    const client = mqtt.connect(url, { clientId: `reconnect-bench-${process.pid}` });
+    return new Promise((resolve, reject) => {
+        client.once('connect', () => resolve(client));
+        client.once('error', reject);
+    });
+}
+
+// One dashboard: counts connections and snapshots, remembers when the
+// latest connection got its snapshot
+function dashboard(url, mode, opts) {
+    const client = {
+        snapshots: 0,           // on the current connection
+        extraSnapshots: 0,      // connections that got more than one
+        devices: 0,
+        attempts: 0,
+        snapshotAt: 0
+    };
+    client.socket = new ReconnectingSocket(() => {
+        client.attempts++;
+        return url;
+    }, undefined, {
+        WebSocket,
+        baseDelay: opts.baseDelay,
+        maxDelay: opts.maxDelay,
+        jitter: mode === 'jitter'
+    });
+    client.socket.onopen = () => {
+        client.snapshots = 0;
+    };
+    client.socket.onmessage = (event) => {
+        const message = JSON.parse(event.data);
+        if (message.type === 'snapshot' && !message.partial) {
+            if (++client.snapshots === 2) {
+                client.extraSnapshots++;
+            }
+            client.devices = message.devices.length;
+            client.snapshotAt = now();
+        }
+    };
+    return client;
+}
+
+function startServer(env) {
+    return spawn(process.execPath, [SERVER], {
+        env: Object.assign({}, process.env, env),
+        stdio: ['ignore', 'ignore', 'inherit']
+    });
+}
+
+async function stopServer(server) {
+    server.kill('SIGTERM');
+    await new Promise((resolve) => server.once('exit', resolve));
+}
+
+async function runMode(mode, opts) {
+    const port = await freePort();
+    const stateDir = fs.mkdtempSync(path.join(os.tmpdir(), 'reconnect-bench-'));
+    const env = {
+        PORT: String(port),
+        STATE_FILE: path.join(stateDir, 'device-state.jsonl'),
+        HISTORY_DIR: '',
+        LOG_LEVEL: 'warn'
+    };
+    let broker = opts.broker;
+    if (!broker) {
+        const mqttPort = await freePort();
+        Object.assign(env, { MQTT_EMBEDDED: '1', MQTT_PORT: String(mqttPort) });
+        broker = `mqtt://127.0.0.1:${mqttPort}`;
+    } else {
+        env.MQTT_BROKER_URL = broker;
+    }
+    const url = `http://127.0.0.1:${port}`;
+    let server = startServer(env);
+    const clients = [];
+    try {
+        await waitFor(async () => (await fetch(`${url}/metrics`)).ok, 15000, 'server.js');
+
+        // Devices known before the restart come back from the state file
+        const publisher = await connectMqtt(broker);
+        for (let i = 0; i < opts.devices; i++) {
+            publisher.publish(`${deviceId(i)}/led/status`, 'LED: OFF #0');
+        }
+        await waitFor(async () => (await (await fetch(`${url}/api/devices`)).json()).length >= opts.devices,
+            10000, 'devices');
+        publisher.end(true);
+
+        for (let i = 0; i < opts.clients; i++) {
+            clients.push(dashboard(`ws://127.0.0.1:${port}`, mode, opts));
+        }
+        await waitFor(() => clients.every((c) => c.snapshotAt > 0), 30000, 'initial snapshots');
+        const attemptsBefore = clients.reduce((sum, c) => sum + c.attempts, 0);
+
+        // Restart
+        const stoppedAt = now();
+        await stopServer(server);
+        await sleep(opts.downtime);
+        server = startServer(env);
+        await waitFor(() => listening(port), 15000, 'server.js to listen again');
+        const upAt = now();
+        const attemptsDown = clients.reduce((sum, c) => sum + c.attempts, 0) - attemptsBefore;
+
+        await waitFor(() => clients.every((c) => c.snapshotAt > upAt), RECOVERY_TIMEOUT_MS, 'recovery');
+        await sleep(200);   // let duplicate snapshots show up
+
+        const recovered = clients.map((c) => c.snapshotAt - upAt);
+        const buckets = new Map();
+        for (const ms of recovered) {
+            const bucket = Math.floor(ms / 100);
+            buckets.set(bucket, (buckets.get(bucket) || 0) + 1);
+        }
+        return {
+            mode,
+            clients: clients.length,
+            recoveredMs: summarize(recovered),
+            outageMs: summarize(clients.map((c) => c.snapshotAt - stoppedAt)),
+            failedAttempts: attemptsDown,
+            peakPer100ms: Math.max(...buckets.values()),
+            resynced: clients.filter((c) => c.devices >= opts.devices && c.snapshots === 1).length,
+            duplicateSnapshots: clients.reduce((sum, c) => sum + c.extraSnapshots, 0)
+        };
+    } finally {
+        clients.forEach((c) => c.socket.close());
+        await stopServer(server);
+        fs.rmSync(stateDir, { recursive: true, force: true });
+    }
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const results = [];
+
+    console.log(`${opts.clients} dashboards, ${opts.devices} devices, server down for ${opts.downtime} ms, ` +
+        `backoff ${opts.baseDelay} ms .. ${opts.maxDelay} ms\n`);
+    console.log('mode     recovered p50   p99   max  outage p99  failed tries  peak/100ms  resynced');
+    for (const mode of opts.modes) {
+        const r = await runMode(mode, opts);
+        results.push(r);
+        console.log(`${mode.padEnd(8)}${r.recoveredMs.p50.toFixed(0).padStart(14)}${r.recoveredMs.p99.toFixed(0).padStart(6)}` +
+            `${r.recoveredMs.max.toFixed(0).padStart(6)}${r.outageMs.p99.toFixed(0).padStart(12)}` +
+            `${String(r.failedAttempts).padStart(14)}${String(r.peakPer100ms).padStart(12)}` +
+            `${`${r.resynced}/${r.clients}`.padStart(10)}`);
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify({ options: opts, results }, null, 2));
+        console.log(`\nResults written to ${opts.json}`);
+    }
+}
+
+main().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});
@@ -0,0 +1,202 @@
+#!/usr/bin/env node
+// Dashboard page load: express.static vs precompressed in-memory assets
+//
+// Serves public/ both ways and loads the dashboard like a browser would
+// (the page, then the scripts it references):
+//
+//   first visit  empty cache, Accept-Encoding: gzip, deflate, br
+//   reload       cached copies revalidated with If-None-Match unless their
+//                Cache-Control says they are still fresh (immutable)
+//
+// For each it reports requests, bytes on the wire (headers included, as
+// read from the socket) and the server-side time to last byte, then models
+// time to first paint (the page itself) and to ready (page + scripts) on a
+// few link profiles: one RTT for TCP, one per request round, plus bytes /
+// bandwidth. The model ignores TLS and TCP slow start; compare with the
+// browser's own numbers (DevTools > Network with throttling) for the real
+// thing.
+//
+// Usage: node bench/static-assets.js [--json results.json]
+
+const http = require('http');
+const zlib = require('zlib');
+const fs = require('fs');
+const path = require('path');
+const express = require('express');
+const { StaticAssets } = require('../lib/static-assets');
+
+const PUBLIC_DIR = path.join(__dirname, '..', 'public');
+const ACCEPT_ENCODING = 'gzip, deflate, br';
+
+const LINKS = [
+    { name: 'slow 3G', rttMs: 400, kbps: 400 },
+    { name: '3G', rttMs: 150, kbps: 1600 },
+    { name: 'WiFi', rttMs: 5, kbps: 30000 }
+];
+
+function parseArgs(argv) {
+    const opts = { json: null };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--json': opts.json = value; break;
+            default:
+                console.error(`Unknown option: ${argv[i]}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+function startApp(mode) {
+    const app = express();
+    if (mode === 'memory') {
+        app.use(new StaticAssets(PUBLIC_DIR).load().middleware());
+    } else {
+        app.use(express.static(PUBLIC_DIR));
+    }
+    return new Promise((resolve) => {
+        const server = http.createServer(app).listen(0, '127.0.0.1', () => resolve(server));
+    });
+}
+
+// One GET over the given keep-alive agent; counts the bytes read from the
+// socket while this request was active
+function get(agent, port, urlPath, headers) {
+    return new Promise((resolve, reject) => {
+        const start = process.hrtime.bigint();
+        const req = http.get({ agent, port, host: '127.0.0.1', path: urlPath, headers }, (res) => {
+            const socket = res.socket;
+            const before = socket.bytesReadBefore || 0;
+            const chunks = [];
+            res.on('data', (chunk) => chunks.push(chunk));
+            res.on('end', () => {
+                socket.bytesReadBefore = socket.bytesRead;
+                resolve({
+                    status: res.statusCode,
+                    headers: res.headers,
+                    body: Buffer.concat(chunks),
+                    wireBytes: socket.bytesRead - before,
+                    ms: Number(process.hrtime.bigint() - start) / 1e6
+                });
+            });
+        });
+        req.on('error', reject);
+    });
+}
+
+function decode(response) {
+    const encoding = response.headers['content-encoding'];
+    if (encoding === 'br') return zlib.brotliDecompressSync(response.body).toString();
+    if (encoding === 'gzip') return zlib.gunzipSync(response.body).toString();
+    return response.body.toString();
+}
+
+function isFresh(cacheControl = '') {
+    return /immutable/.test(cacheControl) || /max-age=[1-9]/.test(cacheControl);
+}
+
+// Load the page and its scripts; `cache` maps URL -> { etag, cacheControl }
+async function loadPage(port, cache) {
+    const agent = new http.Agent({ keepAlive: true, maxSockets: 1 });
+    const rounds = [];
+
+    const fetchResource = async (urlPath) => {
+        const cached = cache.get(urlPath);
+        if (cached && isFresh(cached.cacheControl)) {
+            return { urlPath, fromCache: true, wireBytes: 0, ms: 0 };
+        }
+        const headers = { 'Accept-Encoding': ACCEPT_ENCODING };
+        if (cached && cached.etag) {
+            headers['If-None-Match'] = cached.etag;
+        }
+        const response = await get(agent, port, urlPath, headers);
+        if (response.status === 200) {
+            cache.set(urlPath, {
+                etag: response.headers.etag,
+                cacheControl: response.headers['cache-control'],
+                text: decode(response)
+            });
+        }
+        return Object.assign({ urlPath }, response);
+    };
+
+    const page = await fetchResource('/');
+    rounds.push([page]);
+    const html = cache.get('/').text;
+    const scripts = Array.from(html.matchAll(/<script src="([^"]+)"/g), (m) => `/${m[1]}`);
+    rounds.push(await Promise.all(scripts.map(fetchResource)));
+    agent.destroy();
+    return rounds;
+}
+
+function summarizeLoad(rounds) {
+    const all = [].concat(...rounds);
+    const requested = all.filter((r) => !r.fromCache);
+    return {
+        requests: requested.length,
+        fromCache: all.length - requested.length,
+        wireBytes: requested.reduce((sum, r) => sum + r.wireBytes, 0),
+        pageBytes: rounds[0][0].wireBytes,
+        serverMs: requested.reduce((sum, r) => sum + r.ms, 0),
+        scriptRoundTrips: rounds[1].some((r) => !r.fromCache) ? 1 : 0,
+        scriptBytes: rounds[1].reduce((sum, r) => sum + r.wireBytes, 0),
+        files: all.map((r) => ({ path: r.urlPath, status: r.fromCache ? 'cache' : r.status, bytes: r.wireBytes }))
+    };
+}
+
+// First paint needs the page; ready needs the scripts too
+function model(load, link) {
+    const transfer = (bytes) => bytes * 8 / link.kbps;     // ms
+    const firstPaint = link.rttMs * 2 + transfer(load.pageBytes);
+    const ready = firstPaint + load.scriptRoundTrips * link.rttMs + transfer(load.scriptBytes);
+    return { firstPaint, ready };
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const results = {};
+
+    for (const mode of ['static', 'memory']) {
+        const server = await startApp(mode);
+        const { port } = server.address();
+        const cache = new Map();
+        const first = summarizeLoad(await loadPage(port, cache));
+        const reload = summarizeLoad(await loadPage(port, cache));
+        server.close();
+        results[mode] = { first, reload };
+    }
+
+    const label = { static: 'express.static', memory: 'precompressed' };
+    console.log('                        requests  cached  wire bytes  server ms');
+    for (const visit of ['first', 'reload']) {
+        for (const mode of ['static', 'memory']) {
+            const r = results[mode][visit];
+            console.log(`${(visit + ', ' + label[mode]).padEnd(24)}${String(r.requests).padStart(8)}` +
+                `${String(r.fromCache).padStart(8)}${String(r.wireBytes).padStart(12)}${r.serverMs.toFixed(2).padStart(11)}`);
+        }
+    }
+
+    console.log('\nModelled first paint / ready, ms');
+    console.log('link        visit   express.static    precompressed');
+    for (const link of LINKS) {
+        for (const visit of ['first', 'reload']) {
+            const cell = (mode) => {
+                const m = model(results[mode][visit], link);
+                return `${m.firstPaint.toFixed(0)} / ${m.ready.toFixed(0)}`;
+            };
+            console.log(`${link.name.padEnd(12)}${visit.padEnd(8)}${cell('static').padStart(15)}${cell('memory').padStart(17)}`);
+        }
+    }
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify({ links: LINKS, results }, null, 2));
+        console.log(`\nResults written to ${opts.json}`);
+    }
+}
+
+main().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});
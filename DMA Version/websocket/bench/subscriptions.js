@@ -0,0 +1,268 @@
+#!/usr/bin/env node
+// Subscription filtering benchmark
+//
+// A fleet of devices and a crowd of dashboards that each watch only a few of
+// them. Compares sending every status update to every client (which then
+// throws most of them away) with the device -> subscribers index used by
+// Broadcaster.publish().
+//
+// Clients live in forked worker processes and subscribe through the same
+// WebSocket messages as the dashboard.
+//
+// Usage: node bench/subscriptions.js [--devices 1000] [--clients 1000]
+//                                    [--interest 5] [--updates 1000]
+//                                    [--workers 4] [--seed 1] [--json results.json]
+
+const http = require('http');
+const os = require('os');
+const fs = require('fs');
+const { fork } = require('child_process');
+const WebSocket = require('ws');
+const { Broadcaster, ALL_DEVICES } = require('../lib/broadcast');
+
+// Small deterministic PRNG so every run and every worker agree on who watches what
+function mulberry32(seed) {
+    return () => {
+        seed = (seed + 0x6D2B79F5) | 0;
+        let t = Math.imul(seed ^ (seed >>> 15), 1 | seed);
+        t = (t + Math.imul(t ^ (t >>> 7), 61 | t)) ^ t;
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+const deviceId = (index) => `dev${String(index).padStart(5, '0')}`;
+
+// Devices watched by one client
+function interestOf(clientIndex, opts) {
+    const random = mulberry32(opts.seed * 100003 + clientIndex);
+    const ids = new Set();
+    while (ids.size < Math.min(opts.interest, opts.devices)) {
+        ids.add(deviceId(Math.floor(random() * opts.devices)));
+    }
+    return Array.from(ids);
+}
+
+// ---- Client worker --------------------------------------------------------
+
+function runWorker(port, first, count, opts) {
+    const sockets = [];
+    let open = 0;
+    let received = 0;
+    let next = 0;
+    let pending = 0;
+
+    const connectMore = () => {
+        while (next < count && pending < 200) {
+            const index = first + next;
+            const ws = new WebSocket(`ws://127.0.0.1:${port}`);
+            next++;
+            pending++;
+            ws.on('open', () => {
+                pending--;
+                ws.send(JSON.stringify({ type: 'unsubscribe', devices: [ALL_DEVICES] }));
+                ws.send(JSON.stringify({ type: 'subscribe', devices: interestOf(index, opts) }));
+                if (++open === count) {
+                    process.send({ type: 'ready' });
+                }
+                connectMore();
+            });
+            ws.on('message', () => {
+                received++;
+            });
+            ws.on('error', (error) => {
+                process.send({ type: 'error', message: error.message });
+            });
+            sockets.push(ws);
+        }
+    };
+
+    connectMore();
+    process.on('message', (msg) => {
+        if (msg.type === 'count') {
+            process.send({ type: 'count', received });
+        } else if (msg.type === 'exit') {
+            sockets.forEach((ws) => ws.terminate());
+            process.exit(0);
+        }
+    });
+}
+
+// ---- Server side ----------------------------------------------------------
+
+const strategies = {
+    // Every client gets every update and filters on its own
+    'broadcast'(broadcaster, id, message) {
+        return broadcaster.broadcast(message, id);
+    },
+
+    'indexed'(broadcaster, id, message) {
+        return broadcaster.publish(id, message);
+    }
+};
+
+function parseArgs(argv) {
+    const opts = {
+        devices: 1000,
+        clients: 1000,
+        interest: 5,
+        updates: 1000,
+        workers: Math.max(1, Math.min(4, os.cpus().length - 1)),
+        seed: 1,
+        json: null
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        const key = argv[i].replace(/^--/, '');
+        if (key === 'json') {
+            opts.json = value;
+        } else if (key in opts) {
+            opts[key] = parseInt(value, 10);
+        } else {
+            console.error(`Unknown option: ${argv[i]}`);
+            process.exit(1);
+        }
+        i++;
+    }
+    return opts;
+}
+
+function summarize(samples) {
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        p50: pick(0.5),
+        p95: pick(0.95),
+        mean: samples.reduce((a, b) => a + b, 0) / samples.length
+    };
+}
+
+function request(workers, type) {
+    return Promise.all(workers.map((worker) => new Promise((resolve, reject) => {
+        const onMessage = (msg) => {
+            if (msg.type === type) {
+                worker.removeListener('message', onMessage);
+                resolve(msg);
+            } else if (msg.type === 'error') {
+                reject(new Error(msg.message));
+            }
+        };
+        worker.on('message', onMessage);
+        if (type === 'count') {
+            worker.send({ type });
+        }
+    })));
+}
+
+async function receivedTotal(workers) {
+    const counts = await request(workers, 'count');
+    return counts.reduce((sum, msg) => sum + msg.received, 0);
+}
+
+async function waitForDelivery(workers, expected) {
+    for (;;) {
+        if (await receivedTotal(workers) >= expected) {
+            return;
+        }
+        await new Promise((resolve) => setTimeout(resolve, 5));
+    }
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+
+    const server = http.createServer();
+    const wss = new WebSocket.Server({ server, backlog: 1024 });
+    // No coalescing: every frame counted as sent must reach a client
+    const broadcaster = new Broadcaster({ softLimit: Infinity, hardLimit: Infinity });
+    let subscribed = 0;
+
+    wss.on('connection', (ws) => {
+        broadcaster.add(ws);
+        ws.on('message', (message) => {
+            const data = JSON.parse(message);
+            if (data.type === 'subscribe') {
+                broadcaster.subscribe(ws, data.devices);
+                subscribed++;
+            } else if (data.type === 'unsubscribe') {
+                broadcaster.unsubscribe(ws, data.devices);
+            }
+        });
+        ws.on('close', () => broadcaster.delete(ws));
+    });
+    await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+    const port = server.address().port;
+
+    const workerCount = Math.min(opts.workers, opts.clients);
+    const workers = [];
+    let first = 0;
+    for (let i = 0; i < workerCount; i++) {
+        const share = Math.floor(opts.clients / workerCount) + (i < opts.clients % workerCount ? 1 : 0);
+        workers.push(fork(__filename, ['--worker', String(port), String(first), String(share), JSON.stringify(opts)]));
+        first += share;
+    }
+    await request(workers, 'ready');
+    while (subscribed < opts.clients) {
+        await new Promise((resolve) => setTimeout(resolve, 5));
+    }
+
+    // The same update sequence for both strategies
+    const random = mulberry32(opts.seed);
+    const updates = [];
+    for (let i = 0; i < opts.updates; i++) {
+        updates.push(deviceId(Math.floor(random() * opts.devices)));
+    }
+
+    console.log(`Subscription benchmark: ${opts.devices} devices, ${opts.clients} clients watching ${opts.interest} each, ${opts.updates} updates`);
+    console.log('              dispatch (us/update)         frames      total');
+    console.log('strategy        p50      p95     mean    per update   (ms)');
+
+    const results = { options: opts };
+    for (const [name, dispatch] of Object.entries(strategies)) {
+        const times = [];
+        let frames = 0;
+        const before = await receivedTotal(workers);
+        const start = process.hrtime.bigint();
+
+        for (let i = 0; i < updates.length; i++) {
+            const id = updates[i];
+            const t0 = process.hrtime.bigint();
+            frames += dispatch(broadcaster, id, { type: 'led_state', device: id, state: i % 2 ? 'LED: ON' : 'LED: OFF' });
+            times.push(Number(process.hrtime.bigint() - t0) / 1000);
+
+            // Let the sockets flush now and then, like MQTT traffic would
+            if (i % 100 === 99) {
+                await new Promise((resolve) => setImmediate(resolve));
+            }
+        }
+        await waitForDelivery(workers, before + frames);
+        const total = Number(process.hrtime.bigint() - start) / 1e6;
+
+        const dispatchStats = summarize(times);
+        results[name] = { dispatch: dispatchStats, framesPerUpdate: frames / updates.length, totalMs: total };
+        console.log(
+            `${name.padEnd(10)}${dispatchStats.p50.toFixed(1).padStart(9)}${dispatchStats.p95.toFixed(1).padStart(9)}` +
+            `${dispatchStats.mean.toFixed(1).padStart(9)}${(frames / updates.length).toFixed(1).padStart(13)}` +
+            `${total.toFixed(0).padStart(9)}`
+        );
+    }
+
+    workers.forEach((worker) => worker.send({ type: 'exit' }));
+    broadcaster.clients.forEach((ws) => ws.terminate());
+    wss.close();
+    server.close();
+
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify(results, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+}
+
+if (process.argv[2] === '--worker') {
+    runWorker(parseInt(process.argv[3], 10), parseInt(process.argv[4], 10),
+        parseInt(process.argv[5], 10), JSON.parse(process.argv[6]));
+} else {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}
@@ -0,0 +1,295 @@
+const WebSocket = require('ws');
+const protocol = require('../public/protocol');
+const { createLogger } = require('./log');
+
+// Send buffers as text frames so the browser still receives a string
+const TEXT_FRAME = { binary: false };
+const BINARY_FRAME = { binary: true };
+
+const DEFAULTS = {
+    softLimit: 64 * 1024,       // bytes buffered before state updates are coalesced
+    hardLimit: 1024 * 1024,     // bytes buffered before the client is disconnected
+    maxStallMs: 30000,          // longest a client may stay above softLimit
+    drainInterval: 50,          // ms between checks of congested clients
+    maxSubscriptions: 10000,    // devices a single client may watch
+    log: null                   // Logger (lib/log.js); null: one set up from the environment
+};
+
+// Subscription to every device
+const ALL_DEVICES = '*';
+
+// Serialize a message once into a buffer that can be shared by every socket
+function encode(message) {
+    return Buffer.from(JSON.stringify(message));
+}
+
+// Binary frame of a message (see public/protocol.js), or null if it has none
+function encodeBinary(message) {
+    const bytes = protocol.encodeMessage(message);
+    return bytes ? Buffer.from(bytes.buffer, bytes.byteOffset, bytes.byteLength) : null;
+}
+
+// One message in the wire formats clients asked for. Each format is encoded
+// at most once, on first use, and the buffer is shared by every socket.
+// A Buffer passed in is taken as already encoded JSON.
+class Frames {
+    constructor(message) {
+        this.message = message;
+        this.json = Buffer.isBuffer(message) ? { data: message, options: TEXT_FRAME } : null;
+        this.binary = Buffer.isBuffer(message) ? null : undefined;
+    }
+
+    // { data, options } to send to this client
+    for(client) {
+        if (client.protocol === protocol.BINARY_PROTOCOL && this.binary !== null) {
+            if (this.binary === undefined) {
+                const data = encodeBinary(this.message);
+                this.binary = data ? { data, options: BINARY_FRAME } : null;
+            }
+            if (this.binary) {
+                return this.binary;
+            }
+        }
+        if (!this.json) {
+            this.json = { data: encode(this.message), options: TEXT_FRAME };
+        }
+        return this.json;
+    }
+}
+
+// Fans messages out to the connected dashboards with per-client backpressure.
+//
+// While a socket has less than softLimit bytes queued, frames are sent as
+// usual. Above it, keyed messages (state updates) are no longer queued;
+// only the latest one per key is kept and sent once the socket drains below
+// softLimit again. Clients that exceed hardLimit, or stay congested for
+// longer than maxStallMs, are terminated.
+//
+// Clients that negotiated the binary subprotocol get binary frames for
+// the messages that have one, everybody else gets JSON.
+//
+// Device updates go through publish(), which only visits the clients that
+// subscribed to that device (or to ALL_DEVICES), so an update costs
+// O(interested clients) rather than O(connected clients).
+class Broadcaster {
+    constructor(options = {}) {
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.log = this.opts.log || createLogger();
+        this.clients = new Set();
+        this.subscribers = new Map();   // device id -> Set of clients
+        this.allSubscribers = new Set(); // clients watching every device
+        this.congested = new Map();     // client -> { since, pending: Map(key -> { data, options }) }
+        this.timer = null;
+        this.nextId = 1;
+        this.stats = { sent: 0, coalesced: 0, flushed: 0, disconnected: 0 };
+    }
+
+    // New clients watch every device until they unsubscribe from ALL_DEVICES
+    add(client, info = {}) {
+        client.clientId = this.nextId++;
+        client.clientInfo = info;
+        client.subscriptions = new Set();
+        this.clients.add(client);
+        this.allSubscribers.add(client);
+    }
+
+    delete(client) {
+        this.clients.delete(client);
+        this.congested.delete(client);
+        this.allSubscribers.delete(client);
+        for (const deviceId of client.subscriptions) {
+            this.removeSubscriber(deviceId, client);
+        }
+        client.subscriptions.clear();
+    }
+
+    // Watch devices; ALL_DEVICES subscribes to every device. Returns the IDs
+    // that were newly added (excluding ALL_DEVICES).
+    subscribe(client, deviceIds) {
+        const added = [];
+        for (const deviceId of deviceIds) {
+            if (deviceId === ALL_DEVICES) {
+                this.allSubscribers.add(client);
+            } else if (!client.subscriptions.has(deviceId) &&
+                       client.subscriptions.size < this.opts.maxSubscriptions) {
+                client.subscriptions.add(deviceId);
+                let set = this.subscribers.get(deviceId);
+                if (!set) {
+                    set = new Set();
+                    this.subscribers.set(deviceId, set);
+                }
+                set.add(client);
+                added.push(deviceId);
+            }
+        }
+        return added;
+    }
+
+    unsubscribe(client, deviceIds) {
+        for (const deviceId of deviceIds) {
+            if (deviceId === ALL_DEVICES) {
+                this.allSubscribers.delete(client);
+            } else if (client.subscriptions.delete(deviceId)) {
+                this.removeSubscriber(deviceId, client);
+            }
+        }
+    }
+
+    removeSubscriber(deviceId, client) {
+        const set = this.subscribers.get(deviceId);
+        if (set) {
+            set.delete(client);
+            if (set.size === 0) {
+                this.subscribers.delete(deviceId);
+            }
+        }
+    }
+
+    isSubscribed(client, deviceId) {
+        return this.allSubscribers.has(client) || client.subscriptions.has(deviceId);
+    }
+
+    get size() {
+        return this.clients.size;
+    }
+
+    // Send one message to one client. Messages with a key are state updates
+    // that may be coalesced; messages without one are always queued.
+    send(client, message, key) {
+        if (client.readyState !== WebSocket.OPEN) {
+            return false;
+        }
+        const frame = (message instanceof Frames ? message : new Frames(message)).for(client);
+        const buffered = client.bufferedAmount;
+
+        if (buffered > this.opts.hardLimit) {
+            this.disconnect(client, 'buffer limit');
+            return false;
+        }
+
+        let state = this.congested.get(client);
+        if (!state && buffered > this.opts.softLimit) {
+            state = { since: Date.now(), pending: new Map() };
+            this.congested.set(client, state);
+            this.startDrainTimer();
+        }
+
+        if (state && key !== undefined) {
+            if (state.pending.has(key)) {
+                this.stats.coalesced++;
+            }
+            state.pending.set(key, frame);
+            return true;
+        }
+
+        client.send(frame.data, frame.options);
+        this.stats.sent++;
+        return true;
+    }
+
+    // Send one message to every open client, encoding it a single time.
+    // Returns the number of clients it was sent or queued to.
+    broadcast(message, key) {
+        const data = new Frames(message);
+        let sent = 0;
+
+        for (const client of this.clients) {
+            if (this.send(client, data, key)) {
+                sent++;
+            }
+        }
+        return sent;
+    }
+
+    // Send a device update to the clients watching that device, encoding it
+    // once. Returns the number of clients it was sent or queued to.
+    publish(deviceId, message) {
+        const data = new Frames(message);
+        const watchers = this.subscribers.get(deviceId);
+        let sent = 0;
+
+        for (const client of this.allSubscribers) {
+            if (this.send(client, data, deviceId)) {
+                sent++;
+            }
+        }
+        if (watchers) {
+            for (const client of watchers) {
+                // Clients watching everything were served above
+                if (!this.allSubscribers.has(client) && this.send(client, data, deviceId)) {
+                    sent++;
+                }
+            }
+        }
+        return sent;
+    }
+
+    disconnect(client, reason) {
+        this.stats.disconnected++;
+        this.log.warn(`Disconnecting slow WebSocket client #${client.clientId} (${reason}, ${client.bufferedAmount} bytes queued)`);
+        this.delete(client);
+        client.terminate();
+    }
+
+    startDrainTimer() {
+        if (!this.timer) {
+            this.timer = setInterval(() => this.drain(), this.opts.drainInterval);
+            this.timer.unref();
+        }
+    }
+
+    // Flush the latest coalesced state to clients that have caught up
+    drain() {
+        const now = Date.now();
+
+        for (const [client, state] of this.congested) {
+            if (client.readyState !== WebSocket.OPEN) {
+                this.congested.delete(client);
+            } else if (client.bufferedAmount > this.opts.hardLimit ||
+                       now - state.since > this.opts.maxStallMs) {
+                this.disconnect(client, 'stalled');
+            } else if (client.bufferedAmount <= this.opts.softLimit) {
+                this.congested.delete(client);
+                for (const frame of state.pending.values()) {
+                    client.send(frame.data, frame.options);
+                    this.stats.sent++;
+                    this.stats.flushed++;
+                }
+            }
+        }
+
+        if (this.congested.size === 0) {
+            clearInterval(this.timer);
+            this.timer = null;
+        }
+    }
+
+    // Queue depth of every client: bytes waiting in the socket and state
+    // updates held back by coalescing
+    queueDepths() {
+        const depths = [];
+        for (const client of this.clients) {
+            const state = this.congested.get(client);
+            depths.push({
+                id: client.clientId,
+                address: client.clientInfo.address,
+                bufferedBytes: client.bufferedAmount,
+                subscriptions: this.allSubscribers.has(client) ? ALL_DEVICES : client.subscriptions.size,
+                pendingUpdates: state ? state.pending.size : 0,
+                congestedMs: state ? Date.now() - state.since : 0
+            });
+        }
+        return depths;
+    }
+
+    metrics() {
+        return Object.assign({
+            clients: this.clients.size,
+            congested: this.congested.size,
+            watchingAll: this.allSubscribers.size,
+            watchedDevices: this.subscribers.size
+        }, this.stats, { queues: this.queueDepths() });
+    }
+}
+
+module.exports = { Broadcaster, Frames, encode, encodeBinary, ALL_DEVICES, DEFAULTS };
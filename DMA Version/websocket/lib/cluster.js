@@ -0,0 +1,229 @@
+// Multi-process mode: one MQTT ingest process, N WebSocket workers
+//
+// The primary process owns the MQTT connection, the device states, the
+// command tracker and the files on disk. Workers (node:cluster, sharing the
+// HTTP port) accept the browsers. The two talk over the cluster IPC channel:
+//
+//   primary -> worker   sync      full device list, sent once the worker is ready
+//                       updates   device updates of one event-loop turn
+//                       client    a message for one of the worker's clients (ack)
+//                       collect   ask for a value (e.g. the worker's metrics)
+//                       reply     answer to a worker's request
+//   worker -> primary   ready     listening for IPC messages
+//                       command   an LED command from a browser
+//                       request   ask the primary for a value
+//                       collected answer to a collect
+//
+// Updates are batched per event-loop turn so a burst of statuses costs one
+// IPC message per worker rather than one per status and worker.
+
+const cluster = require('cluster');
+const { EventEmitter } = require('events');
+
+const DEFAULTS = {
+    restartDelay: 1000,     // ms before replacing a worker that exited
+    collectTimeout: 2000    // ms to wait for every worker to answer a collect
+};
+
+// ---- Primary side ---------------------------------------------------------
+
+class WorkerPool extends EventEmitter {
+    // snapshot() returns the device list sent to new workers;
+    // handlers[what](payload, worker) answers worker requests (may be async)
+    constructor(count, snapshot, handlers, options = {}) {
+        super();
+        this.count = count;
+        this.snapshot = snapshot;
+        this.handlers = handlers;
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.ready = new Map();         // worker id -> worker receiving updates
+        this.batch = [];
+        this.flushScheduled = false;
+        this.collects = new Map();      // request id -> { replies, waiting, resolve, timer }
+        this.nextRequest = 0;
+        this.stopping = false;
+        this.stats = { updates: 0, batches: 0, restarts: 0 };
+    }
+
+    start() {
+        cluster.on('message', (worker, message) => this.onMessage(worker, message));
+        cluster.on('exit', (worker, code, signal) => {
+            this.ready.delete(worker.id);
+            this.emit('exit', worker, code, signal);
+            if (!this.stopping) {
+                this.stats.restarts++;
+                setTimeout(() => cluster.fork(), this.opts.restartDelay);
+            }
+        });
+        for (let i = 0; i < this.count; i++) {
+            cluster.fork();
+        }
+        return this;
+    }
+
+    stop() {
+        this.stopping = true;
+        for (const worker of Object.values(cluster.workers)) {
+            worker.kill();
+        }
+    }
+
+    async onMessage(worker, message) {
+        switch (message.type) {
+            case 'ready':
+                // The device list goes out before any update on this channel
+                worker.send({ type: 'sync', devices: this.snapshot() });
+                this.ready.set(worker.id, worker);
+                this.emit('ready', worker);
+                break;
+            case 'request': {
+                let value = null;
+                let error = null;
+                try {
+                    value = await this.handlers[message.what](message.payload, worker);
+                } catch (e) {
+                    error = e.message;
+                }
+                if (worker.isConnected()) {
+                    worker.send({ type: 'reply', id: message.id, value, error });
+                }
+                break;
+            }
+            case 'collected': {
+                const pending = this.collects.get(message.id);
+                if (pending) {
+                    pending.replies.push(message.value);
+                    if (--pending.waiting === 0) {
+                        this.finishCollect(message.id);
+                    }
+                }
+                break;
+            }
+            default:
+                this.emit(message.type, message, worker);
+        }
+    }
+
+    // Queue a device update for every worker; sent at the end of this turn
+    publish(update, isNew) {
+        this.batch.push(isNew ? [update, 1] : [update]);
+        this.stats.updates++;
+        if (!this.flushScheduled) {
+            this.flushScheduled = true;
+            setImmediate(() => this.flush());
+        }
+    }
+
+    flush() {
+        this.flushScheduled = false;
+        if (this.batch.length === 0) {
+            return;
+        }
+        const message = { type: 'updates', updates: this.batch };
+        this.batch = [];
+        this.stats.batches++;
+        for (const worker of this.ready.values()) {
+            worker.send(message);
+        }
+    }
+
+    // Message for one client of one worker
+    sendToClient(workerId, clientId, message) {
+        const worker = this.ready.get(workerId);
+        if (worker) {
+            this.flush();   // keep acks behind the updates they refer to
+            worker.send({ type: 'client', clientId, message });
+        }
+    }
+
+    // Ask every ready worker for a value; resolves with the answers that
+    // arrived within collectTimeout
+    collect(what) {
+        const workers = Array.from(this.ready.values());
+        if (workers.length === 0) {
+            return Promise.resolve([]);
+        }
+        const id = ++this.nextRequest;
+        return new Promise((resolve) => {
+            const timer = setTimeout(() => this.finishCollect(id), this.opts.collectTimeout);
+            this.collects.set(id, { replies: [], waiting: workers.length, resolve, timer });
+            for (const worker of workers) {
+                worker.send({ type: 'collect', id, what });
+            }
+        });
+    }
+
+    finishCollect(id) {
+        const pending = this.collects.get(id);
+        this.collects.delete(id);
+        clearTimeout(pending.timer);
+        pending.resolve(pending.replies);
+    }
+
+    metrics() {
+        return Object.assign({ workers: this.ready.size }, this.stats);
+    }
+}
+
+// ---- Worker side ----------------------------------------------------------
+
+class PrimaryLink extends EventEmitter {
+    // handlers[what]() answers the primary's collect requests (may be async)
+    constructor(handlers) {
+        super();
+        this.handlers = handlers;
+        this.requests = new Map();      // request id -> { resolve, reject }
+        this.nextRequest = 0;
+        this.stats = { updates: 0, batches: 0 };
+    }
+
+    start() {
+        process.on('message', (message) => this.onMessage(message));
+        process.send({ type: 'ready' });
+        return this;
+    }
+
+    async onMessage(message) {
+        switch (message.type) {
+            case 'updates':
+                this.stats.batches++;
+                this.stats.updates += message.updates.length;
+                for (const [update, isNew] of message.updates) {
+                    this.emit('update', update, isNew === 1);
+                }
+                break;
+            case 'reply': {
+                const pending = this.requests.get(message.id);
+                if (pending) {
+                    this.requests.delete(message.id);
+                    if (message.error) {
+                        pending.reject(new Error(message.error));
+                    } else {
+                        pending.resolve(message.value);
+                    }
+                }
+                break;
+            }
+            case 'collect':
+                process.send({ type: 'collected', id: message.id, value: await this.handlers[message.what]() });
+                break;
+            default:
+                this.emit(message.type, message);
+        }
+    }
+
+    send(message) {
+        process.send(message);
+    }
+
+    // Ask the primary for a value
+    request(what, payload) {
+        const id = ++this.nextRequest;
+        return new Promise((resolve, reject) => {
+            this.requests.set(id, { resolve, reject });
+            process.send({ type: 'request', id, what, payload });
+        });
+    }
+}
+
+module.exports = { WorkerPool, PrimaryLink, DEFAULTS };
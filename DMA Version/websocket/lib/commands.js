@@ -0,0 +1,231 @@
+// Pending LED commands and their acknowledgements
+//
+// Every control command gets a per-device sequence number and waits in a
+// table keyed by "<device>#<seq>" until the device reports a matching
+// status. Firmware that supports it echoes the number ("on#7" ->
+// "LED: ON #7"); for older firmware the oldest pending command asking for
+// the reported state is taken as acknowledged. The same fallback applies
+// to "#0" (the firmware's answer to a command sent without a number) and to
+// numbers that match no pending command.
+//
+// Whether a device echoes numbers is learnt from its statuses, retained ones
+// included, and kept in the state file together with the last number used
+// (persisted() / restore()), so the first command after a restart is
+// already numbered and does not reuse a number the device still reports.
+//
+// Unanswered commands are republished up to `retries` times, then failed.
+// Acknowledging a command supersedes older pending ones for the same device,
+// so a late retry can never undo a newer command.
+//
+// Commands are debounced per device: at most one is published every
+// `debounce` ms, and while a device is inside that window only the latest
+// submitted command is kept (last writer wins). Publishing a command also
+// stops the retries of the one before it.
+//
+// Events: 'ack' (command) and 'nack' (command, reason). command.rtt is the
+// time from the first publish to the acknowledging status, in ms.
+
+const { EventEmitter } = require('events');
+
+const DEFAULTS = {
+    timeout: 2000,      // ms to wait for a status before retrying
+    debounce: 100,      // minimum ms between commands to one device
+    retries: 2,         // republish attempts after the first one
+    rttSamples: 1024    // recent round trips kept for statistics
+};
+
+// "LED: ON #7" -> { state: 'LED: ON', seq: 7 }
+function parseStatus(text) {
+    const match = /^(.*?)\s*#(\d+)$/.exec(text);
+    return match ? { state: match[1], seq: parseInt(match[2], 10) } : { state: text, seq: null };
+}
+
+// 'on' / 'off' from a status such as "STM32 Connected - LED: OFF"
+function ledValue(state) {
+    const match = /LED:\s*(ON|OFF)/i.exec(state);
+    return match ? match[1].toLowerCase() : null;
+}
+
+class CommandTracker extends EventEmitter {
+    // publish(deviceId, payload) sends the payload to the device's control topic
+    constructor(publish, options = {}) {
+        super();
+        this.publish = publish;
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.pending = new Map();       // "<device>#<seq>" -> command (published)
+        this.queued = new Map();        // device -> command waiting for its debounce window
+        this.lastSent = new Map();      // device -> time of the last publish
+        this.nextSeq = new Map();       // device -> next sequence number
+        this.echoesSeq = new Set();     // devices whose firmware echoes "#<seq>"
+        this.rtts = [];
+        this.stats = { submitted: 0, sent: 0, coalesced: 0, acked: 0, retried: 0, timedOut: 0, superseded: 0 };
+    }
+
+    // Send a command ('on' / 'off'); origin is handed back with ack / nack
+    submit(deviceId, state, origin) {
+        const seq = this.nextSeq.get(deviceId) || 1;
+        this.nextSeq.set(deviceId, seq + 1);
+
+        const command = {
+            deviceId,
+            seq,
+            state,
+            origin,
+            attempts: 0,
+            submittedAt: Date.now(),
+            sentAt: null,
+            timer: null,
+            rtt: null
+        };
+        this.stats.submitted++;
+
+        // Last writer wins: a newer command replaces one that is still waiting
+        const previous = this.queued.get(deviceId);
+        if (previous) {
+            clearTimeout(previous.timer);
+            this.queued.delete(deviceId);
+            this.stats.coalesced++;
+            this.emit('nack', previous, 'superseded');
+        }
+
+        const wait = (this.lastSent.get(deviceId) || 0) + this.opts.debounce - Date.now();
+        if (wait <= 0) {
+            this.send(command);
+        } else {
+            this.queued.set(deviceId, command);
+            command.timer = setTimeout(() => {
+                this.queued.delete(deviceId);
+                this.send(command);
+            }, wait);
+        }
+        return command;
+    }
+
+    // First publish of a command; older commands to the device stop retrying
+    send(command) {
+        for (const other of Array.from(this.pending.values())) {
+            if (other.deviceId === command.deviceId) {
+                this.stats.superseded++;
+                this.finish(other, 'nack', 'superseded');
+            }
+        }
+        command.sentAt = Date.now();
+        this.pending.set(`${command.deviceId}#${command.seq}`, command);
+        this.stats.sent++;
+        this.transmit(command);
+    }
+
+    transmit(command) {
+        command.attempts++;
+        this.lastSent.set(command.deviceId, Date.now());
+        const payload = this.echoesSeq.has(command.deviceId)
+            ? `${command.state}#${command.seq}`
+            : command.state;
+        this.publish(command.deviceId, payload);
+        command.timer = setTimeout(() => this.onTimeout(command), this.opts.timeout);
+    }
+
+    onTimeout(command) {
+        if (command.attempts <= this.opts.retries) {
+            this.stats.retried++;
+            this.transmit(command);
+        } else {
+            this.stats.timedOut++;
+            this.finish(command, 'nack', 'timeout');
+        }
+    }
+
+    // Note what a status tells about the device's firmware without treating
+    // it as an acknowledgement (retained statuses)
+    learn(deviceId, text) {
+        const { seq } = parseStatus(text);
+        if (seq !== null) {
+            this.echoesSeq.add(deviceId);
+            if (seq >= (this.nextSeq.get(deviceId) || 1)) {
+                this.nextSeq.set(deviceId, seq + 1);
+            }
+        }
+    }
+
+    // Handle a status message; returns the state with any "#<seq>" removed
+    onStatus(deviceId, text) {
+        const { state, seq } = parseStatus(text);
+        let acked = null;
+
+        if (seq !== null) {
+            this.echoesSeq.add(deviceId);
+            // #0 answers a command that was sent without a number
+            if (seq > 0) {
+                acked = this.pending.get(`${deviceId}#${seq}`) || null;
+            }
+        }
+        if (!acked) {
+            // No (known) sequence number: oldest pending command asking for this state
+            const value = ledValue(state);
+            for (const command of this.pending.values()) {
+                if (command.deviceId === deviceId && command.state === value) {
+                    acked = command;
+                    break;
+                }
+            }
+        }
+
+        if (acked) {
+            for (const command of Array.from(this.pending.values())) {
+                if (command.deviceId === deviceId && command.seq < acked.seq) {
+                    this.stats.superseded++;
+                    this.finish(command, 'nack', 'superseded');
+                }
+            }
+            acked.rtt = Date.now() - acked.sentAt;
+            this.recordRtt(acked.rtt);
+            this.stats.acked++;
+            this.finish(acked, 'ack');
+        }
+        return state;
+    }
+
+    // Sequence state of a device worth keeping across restarts, or null
+    persisted(deviceId) {
+        const nextSeq = this.nextSeq.get(deviceId);
+        if (!nextSeq && !this.echoesSeq.has(deviceId)) {
+            return null;
+        }
+        return { echoesSeq: this.echoesSeq.has(deviceId), commandSeq: (nextSeq || 1) - 1 };
+    }
+
+    // Take back what persisted() returned, from the saved device entries
+    restore(entries) {
+        for (const entry of entries) {
+            if (entry.echoesSeq) {
+                this.echoesSeq.add(entry.id);
+            }
+            if (entry.commandSeq > 0) {
+                this.nextSeq.set(entry.id, entry.commandSeq + 1);
+            }
+        }
+    }
+
+    finish(command, event, reason) {
+        clearTimeout(command.timer);
+        this.pending.delete(`${command.deviceId}#${command.seq}`);
+        this.emit(event, command, reason);
+    }
+
+    recordRtt(rtt) {
+        this.rtts.push(rtt);
+        if (this.rtts.length > this.opts.rttSamples) {
+            this.rtts.shift();
+        }
+    }
+
+    metrics() {
+        const sorted = this.rtts.slice().sort((a, b) => a - b);
+        const pick = (q) => (sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))] : null);
+        return Object.assign({ pending: this.pending.size, queued: this.queued.size }, this.stats, {
+            rttMs: { samples: sorted.length, p50: pick(0.5), p95: pick(0.95), max: pick(1) }
+        });
+    }
+}
+
+module.exports = { CommandTracker, parseStatus, ledValue, DEFAULTS };
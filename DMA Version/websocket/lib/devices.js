@@ -0,0 +1,104 @@
+// Device registry for a fleet of LED controllers
+//
+// Each board publishes on "<device id>/led/status" and listens on
+// "<device id>/led/control" (the firmware derives the ID from the STM32's
+// 96-bit unique ID). Boards running older firmware use the unprefixed
+// "led/..." topics and show up as LEGACY_DEVICE_ID.
+
+const LEGACY_DEVICE_ID = 'default';
+
+const TOPIC_STATUS = 'led/status';
+const TOPIC_CONTROL = 'led/control';
+const TOPIC_STATUS_REQUEST = 'led/status_request';
+
+// MQTT subscriptions covering every device
+const STATUS_SUBSCRIPTIONS = [`+/${TOPIC_STATUS}`, TOPIC_STATUS];
+
+// Split "<device id>/led/status" into its device ID and topic suffix.
+// Returns null for topics that do not belong to a device.
+function parseTopic(topic) {
+    if (topic.startsWith('led/')) {
+        return { deviceId: LEGACY_DEVICE_ID, suffix: topic };
+    }
+    const slash = topic.indexOf('/');
+    if (slash <= 0 || !topic.startsWith('led/', slash + 1)) {
+        return null;
+    }
+    return { deviceId: topic.slice(0, slash), suffix: topic.slice(slash + 1) };
+}
+
+// Topic for a device, e.g. deviceTopic('3F0025...', 'led/control')
+function deviceTopic(deviceId, suffix) {
+    return deviceId === LEGACY_DEVICE_ID ? suffix : `${deviceId}/${suffix}`;
+}
+
+// Device IDs travel in topics, so they must be a single, wildcard-free level
+function isValidDeviceId(deviceId) {
+    return typeof deviceId === 'string' && deviceId.length > 0 && deviceId.length <= 64 &&
+        !/[/+#\s]/.test(deviceId);
+}
+
+class DeviceRegistry {
+    constructor() {
+        this.devices = new Map();   // device id -> { id, state, seq, updatedAt }
+    }
+
+    get size() {
+        return this.devices.size;
+    }
+
+    has(deviceId) {
+        return this.devices.has(deviceId);
+    }
+
+    get(deviceId) {
+        return this.devices.get(deviceId);
+    }
+
+    // Record a status message; returns the device entry. seq counts the
+    // updates of each device so clients can order them.
+    update(deviceId, state, updatedAt = Date.now()) {
+        let device = this.devices.get(deviceId);
+        if (!device) {
+            device = { id: deviceId, state, seq: 1, updatedAt };
+            this.devices.set(deviceId, device);
+        } else {
+            device.state = state;
+            device.seq++;
+            device.updatedAt = updatedAt;
+        }
+        return device;
+    }
+
+    // Load saved entries (see lib/state-store.js); newer updates continue
+    // their sequence numbers
+    restore(entries) {
+        for (const entry of entries) {
+            if (isValidDeviceId(entry.id)) {
+                this.devices.set(entry.id, {
+                    id: entry.id,
+                    state: String(entry.state),
+                    seq: entry.seq || 0,
+                    updatedAt: entry.updatedAt || 0
+                });
+            }
+        }
+    }
+
+    // All device states, for the snapshot frame sent to new clients
+    snapshot() {
+        return Array.from(this.devices.values());
+    }
+}
+
+module.exports = {
+    DeviceRegistry,
+    parseTopic,
+    deviceTopic,
+    isValidDeviceId,
+    LEGACY_DEVICE_ID,
+    TOPIC_STATUS,
+    TOPIC_CONTROL,
+    TOPIC_STATUS_REQUEST,
+    STATUS_SUBSCRIPTIONS
+};
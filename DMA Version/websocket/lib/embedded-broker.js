@@ -0,0 +1,138 @@
+// In-process MQTT broker (aedes)
+//
+// Lets server.js act as the broker itself: devices connect straight to the
+// dashboard server on MQTT_PORT, and the server's own publishes and
+// subscriptions are delivered through function calls instead of a loopback
+// TCP connection to mosquitto.
+//
+// `aedes` is an optional dependency and is only loaded when this mode is used.
+
+const net = require('net');
+const { EventEmitter } = require('events');
+const { createLogger } = require('./log');
+
+// Minimal stand-in for an mqtt.js client, backed by the broker in this
+// process. Supports the subset server.js uses: 'connect' and 'message'
+// events, subscribe(), unsubscribe(), publish() and end(). Like a network
+// client, a new subscription first receives the matching retained messages
+// (packet.retain set); live messages always arrive with retain cleared, even
+// when the publisher set it, as MQTT does for established subscriptions.
+class EmbeddedClient extends EventEmitter {
+    constructor(broker) {
+        super();
+        this.broker = broker;
+        this.connected = true;
+        this.subscriptions = new Set();
+
+        // aedes calls this for every matching publish, device or local. The
+        // packet carries the publisher's retain flag, which must not reach
+        // server.js: it would take a live status for a replayed one.
+        this.deliver = (packet, done) => {
+            this.emit('message', packet.topic, packet.payload, Object.assign({}, packet, { retain: false }));
+            done();
+        };
+
+        setImmediate(() => this.emit('connect'));
+    }
+
+    subscribe(topics, options, callback) {
+        if (typeof options === 'function') {
+            callback = options;
+        }
+        const list = (Array.isArray(topics) ? topics : [topics]).filter((t) => !this.subscriptions.has(t));
+        let remaining = list.length;
+
+        if (remaining === 0) {
+            if (callback) setImmediate(callback, null);
+            return this;
+        }
+        list.forEach((topic) => {
+            this.subscriptions.add(topic);
+            this.broker.subscribe(topic, this.deliver, () => {
+                if (--remaining === 0) {
+                    this.deliverRetained(list, callback);
+                }
+            });
+        });
+        return this;
+    }
+
+    // Replay the broker's retained messages for new subscriptions
+    deliverRetained(topics, callback) {
+        const persistence = this.broker.persistence;
+        if (!persistence || typeof persistence.createRetainedStreamCombi !== 'function') {
+            if (callback) callback(null);
+            return;
+        }
+        persistence.createRetainedStreamCombi(topics)
+            .on('data', (packet) => {
+                this.emit('message', packet.topic, packet.payload, Object.assign({}, packet, { retain: true }));
+            })
+            .on('error', (err) => {
+                if (callback) callback(err);
+                callback = null;
+            })
+            .on('end', () => {
+                if (callback) callback(null);
+            });
+    }
+
+    unsubscribe(topics, callback) {
+        (Array.isArray(topics) ? topics : [topics]).forEach((topic) => {
+            if (this.subscriptions.delete(topic)) {
+                this.broker.unsubscribe(topic, this.deliver, () => {});
+            }
+        });
+        if (callback) setImmediate(callback);
+        return this;
+    }
+
+    publish(topic, payload, options, callback) {
+        if (typeof options === 'function') {
+            callback = options;
+            options = {};
+        }
+        options = options || {};
+        this.broker.publish({
+            cmd: 'publish',
+            topic,
+            payload: Buffer.isBuffer(payload) ? payload : Buffer.from(String(payload)),
+            qos: options.qos || 0,
+            retain: !!options.retain,
+            dup: false
+        }, (err) => {
+            if (callback) callback(err || null);
+        });
+        return this;
+    }
+
+    end(force, options, callback) {
+        const done = [force, options, callback].find((arg) => typeof arg === 'function');
+        this.unsubscribe(Array.from(this.subscriptions));
+        this.connected = false;
+        if (done) setImmediate(done);
+        return this;
+    }
+}
+
+// Start the broker on `port` and return { broker, server, client }.
+// options: host (default all interfaces), log (Logger from lib/log.js)
+function startEmbeddedBroker(port, options = {}) {
+    const { host = '0.0.0.0', log = createLogger() } = options;
+    const broker = require('aedes')();
+    const server = net.createServer(broker.handle);
+
+    server.listen(port, host, () => {
+        log.info(`Embedded MQTT broker listening on port ${port}`);
+    });
+    broker.on('client', (client) => {
+        log.info(`MQTT client connected: ${client.id}`);
+    });
+    broker.on('clientDisconnect', (client) => {
+        log.info(`MQTT client disconnected: ${client.id}`);
+    });
+
+    return { broker, server, client: new EmbeddedClient(broker) };
+}
+
+module.exports = { startEmbeddedBroker, EmbeddedClient };
@@ -0,0 +1,55 @@
+// WebSocket heartbeat
+//
+// A phone that goes to sleep or drops off WiFi rarely closes its socket, so
+// the server never sees 'close' and keeps the half-open connection in the
+// client set. Every `interval` ms each client is pinged; a client that has
+// not answered the previous ping with a pong by then is terminated, so a
+// dead connection is reaped within two intervals.
+
+class Heartbeat {
+    // onReap(client) is called before an unresponsive client is terminated
+    constructor(clients, options = {}) {
+        this.clients = clients;
+        this.interval = options.interval ?? 30000;    // 0 disables the heartbeat
+        this.onReap = options.onReap || (() => {});
+        this.timer = null;
+        this.stats = { pings: 0, reaped: 0 };
+    }
+
+    // Start tracking a newly connected client
+    watch(client) {
+        client.isAlive = true;
+        client.on('pong', () => {
+            client.isAlive = true;
+        });
+    }
+
+    start() {
+        if (!this.timer && this.interval > 0) {
+            this.timer = setInterval(() => this.check(), this.interval);
+            this.timer.unref();
+        }
+        return this;
+    }
+
+    stop() {
+        clearInterval(this.timer);
+        this.timer = null;
+    }
+
+    check() {
+        for (const client of Array.from(this.clients)) {
+            if (client.isAlive === false) {
+                this.stats.reaped++;
+                this.onReap(client);
+                client.terminate();
+            } else {
+                client.isAlive = false;
+                client.ping();
+                this.stats.pings++;
+            }
+        }
+    }
+}
+
+module.exports = { Heartbeat };
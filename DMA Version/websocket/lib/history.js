@@ -0,0 +1,348 @@
+// Append-only event history on local disk
+//
+// Every status and command event is appended to a binary log split into
+// segment files (events-<first time>.log). A segment is closed once it
+// reaches `segmentSize` bytes; the oldest are deleted beyond `maxSegments`.
+//
+// Record (little endian):
+//
+//   0   u16  record length in bytes, header included
+//   2   u8   kind (KIND_*)
+//   3   u8   device ID length
+//   4   f64  time, ms since the epoch (never decreases within the log)
+//   12  device ID (ASCII), then the event data (UTF-8) to the end
+//
+// The in-memory index keeps, per segment, its time range, the devices it
+// contains and a sparse (time, offset) entry every `indexEvery` records.
+// A range query skips segments outside the range or without the device,
+// seeks to the indexed offset just before the start time and streams from
+// there, so it never holds more than one read chunk of a segment in memory.
+//
+// Appends are buffered and written every `flushInterval` ms (or once
+// `flushSize` bytes are waiting); queries only read what has been written.
+
+const fs = require('fs');
+const path = require('path');
+const { createLogger } = require('./log');
+
+const KIND_STATUS = 1;      // data: status text
+const KIND_COMMAND = 2;     // data: "on#7"
+const KIND_ACK = 3;         // data: "on#7 rtt=42"
+const KIND_NACK = 4;        // data: "on#7 timeout"
+
+const KIND_NAMES = { 1: 'status', 2: 'command', 3: 'ack', 4: 'nack' };
+
+const HEADER_SIZE = 12;
+const MAX_RECORD = 0xFFFF;
+
+const DEFAULTS = {
+    segmentSize: 8 * 1024 * 1024,   // bytes per segment file
+    maxSegments: 64,                // oldest segments beyond this are deleted
+    indexEvery: 256,                // records between sparse index entries
+    flushInterval: 200,             // ms between writes of buffered records
+    flushSize: 64 * 1024,           // bytes buffered before writing early
+    log: null                       // Logger (lib/log.js); null: one set up from the environment
+};
+
+function encodeRecord(time, kind, deviceId, data) {
+    const idLength = Buffer.byteLength(deviceId, 'latin1');
+    const dataLength = Buffer.byteLength(data, 'utf8');
+    const length = Math.min(HEADER_SIZE + idLength + dataLength, MAX_RECORD);
+    const record = Buffer.alloc(length);
+    record.writeUInt16LE(length, 0);
+    record.writeUInt8(kind, 2);
+    record.writeUInt8(idLength, 3);
+    record.writeDoubleLE(time, 4);
+    record.write(deviceId, HEADER_SIZE, idLength, 'latin1');
+    record.write(data, HEADER_SIZE + idLength, length - HEADER_SIZE - idLength, 'utf8');
+    return record;
+}
+
+function decodeRecord(buffer, offset) {
+    const length = buffer.readUInt16LE(offset);
+    const idLength = buffer.readUInt8(offset + 3);
+    const idStart = offset + HEADER_SIZE;
+    return {
+        length,
+        time: buffer.readDoubleLE(offset + 4),
+        kind: buffer.readUInt8(offset + 2),
+        device: buffer.toString('latin1', idStart, idStart + idLength),
+        data: buffer.toString('utf8', idStart + idLength, offset + length)
+    };
+}
+
+class Segment {
+    constructor(file, firstTime) {
+        this.file = file;
+        this.firstTime = firstTime;
+        this.lastTime = firstTime;
+        this.size = 0;          // bytes appended (written or buffered)
+        this.written = 0;       // bytes on disk
+        this.records = 0;
+        this.devices = new Set();
+        this.index = [];        // [time, offset] every indexEvery records
+    }
+
+    // Offset of the last indexed record at or before `time`
+    seek(time) {
+        let lo = 0;
+        let hi = this.index.length - 1;
+        let offset = 0;
+        while (lo <= hi) {
+            const mid = (lo + hi) >> 1;
+            if (this.index[mid][0] < time) {
+                offset = this.index[mid][1];
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        return offset;
+    }
+}
+
+class EventHistory {
+    constructor(dir, options = {}) {
+        this.dir = dir;
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.log = this.opts.log || createLogger();
+        this.segments = [];
+        this.current = null;
+        this.fd = null;
+        this.buffer = [];
+        this.buffered = 0;
+        this.timer = null;
+        this.lastTime = 0;
+        this.stats = { appended: 0, dropped: 0, segmentsDeleted: 0, queries: 0 };
+    }
+
+    // Rebuild the index from the segments on disk
+    open() {
+        fs.mkdirSync(this.dir, { recursive: true });
+        const files = fs.readdirSync(this.dir)
+            .filter((name) => /^events-\d+\.log$/.test(name))
+            .sort((a, b) => parseInt(a.slice(7), 10) - parseInt(b.slice(7), 10));
+
+        for (const name of files) {
+            const segment = new Segment(path.join(this.dir, name), parseInt(name.slice(7), 10));
+            this.scan(segment);
+            this.segments.push(segment);
+            this.lastTime = Math.max(this.lastTime, segment.lastTime);
+        }
+        this.trim();
+        return this;
+    }
+
+    // Read a segment once to rebuild its index; a torn record at the end
+    // (crash during a write) is cut off
+    scan(segment) {
+        const fd = fs.openSync(segment.file, 'r');
+        const chunk = Buffer.allocUnsafe(256 * 1024);
+        let carry = Buffer.alloc(0);
+        let position = 0;
+        let bytes;
+
+        while ((bytes = fs.readSync(fd, chunk, 0, chunk.length, position)) > 0) {
+            const data = carry.length ? Buffer.concat([carry, chunk.subarray(0, bytes)]) : chunk.subarray(0, bytes);
+            let offset = 0;
+            while (offset + 2 <= data.length) {
+                const length = data.readUInt16LE(offset);
+                if (length < HEADER_SIZE || offset + length > data.length) {
+                    break;
+                }
+                this.indexRecord(segment, decodeRecord(data, offset), segment.size);
+                segment.size += length;
+                offset += length;
+            }
+            carry = Buffer.from(data.subarray(offset));
+            position += bytes;
+        }
+        fs.closeSync(fd);
+
+        if (segment.size < position) {
+            fs.truncateSync(segment.file, segment.size);
+        }
+        segment.written = segment.size;
+    }
+
+    indexRecord(segment, record, offset) {
+        if (segment.records % this.opts.indexEvery === 0) {
+            segment.index.push([record.time, offset]);
+        }
+        segment.records++;
+        segment.lastTime = record.time;
+        segment.devices.add(record.device);
+    }
+
+    append(kind, deviceId, data, time = Date.now()) {
+        // Keep times ordered so the index can be searched
+        time = Math.max(time, this.lastTime);
+        this.lastTime = time;
+
+        if (!this.current || this.current.size >= this.opts.segmentSize) {
+            this.roll(time);
+        }
+        const record = encodeRecord(time, kind, deviceId, String(data));
+        this.indexRecord(this.current, { time, device: deviceId }, this.current.size);
+        this.current.size += record.length;
+        this.buffer.push(record);
+        this.buffered += record.length;
+        this.stats.appended++;
+
+        if (this.buffered >= this.opts.flushSize) {
+            this.flush();
+        } else if (!this.timer) {
+            this.timer = setTimeout(() => this.flush(), this.opts.flushInterval);
+        }
+    }
+
+    // Start a new segment (writing out what the old one still buffers)
+    roll(time) {
+        if (this.current) {
+            this.flush();
+            fs.closeSync(this.fd);
+        }
+        const segment = new Segment(path.join(this.dir, `events-${Math.floor(time)}.log`), time);
+        this.fd = fs.openSync(segment.file, 'a');
+        this.current = segment;
+        this.segments.push(segment);
+        this.trim();
+    }
+
+    // Delete the oldest segments beyond maxSegments
+    trim() {
+        while (this.segments.length > this.opts.maxSegments) {
+            const old = this.segments.shift();
+            fs.unlink(old.file, () => {});
+            this.stats.segmentsDeleted++;
+        }
+    }
+
+    flush() {
+        clearTimeout(this.timer);
+        this.timer = null;
+        if (this.buffered === 0) {
+            return;
+        }
+        const data = Buffer.concat(this.buffer, this.buffered);
+        const count = this.buffer.length;
+        this.buffer = [];
+        this.buffered = 0;
+        try {
+            fs.writeSync(this.fd, data);
+            this.current.written += data.length;
+        } catch (error) {
+            this.stats.dropped += count;
+            this.log.warn(`Cannot write event history: ${error.message}`);
+            this.unindex(this.current, count);
+        }
+    }
+
+    // Forget the last `count` records of a segment that never made it to
+    // disk, so the sizes and index offsets match the file again. A partly
+    // written batch is cut off the file.
+    unindex(segment, count) {
+        segment.size = segment.written;
+        segment.records -= count;
+        while (segment.index.length > 0 && segment.index[segment.index.length - 1][1] >= segment.written) {
+            segment.index.pop();
+        }
+        try {
+            fs.ftruncateSync(this.fd, segment.written);
+        } catch (error) {
+            // Nothing more to undo; the next scan() cuts a torn record
+        }
+    }
+
+    close() {
+        if (this.current) {
+            this.flush();
+            fs.closeSync(this.fd);
+            this.current = null;
+        }
+    }
+
+    // Events of one device (or all, when deviceId is empty) with from <= time
+    // <= to, oldest first. Yields records one at a time while reading.
+    async *query({ deviceId = null, from = 0, to = Infinity, limit = Infinity } = {}) {
+        this.stats.queries++;
+        let count = 0;
+
+        for (const segment of this.segments.slice()) {
+            if (segment.lastTime < from || segment.firstTime > to || segment.written === 0 ||
+                (deviceId && !segment.devices.has(deviceId))) {
+                continue;
+            }
+            // The index also covers records still in the write buffer; those
+            // are not on disk yet, and neither is anything from `from` on
+            const start = segment.seek(from);
+            if (start >= segment.written) {
+                continue;
+            }
+            const stream = fs.createReadStream(segment.file, {
+                start,
+                end: segment.written - 1,
+                highWaterMark: 64 * 1024
+            });
+            let carry = null;
+            try {
+                chunks: for await (const chunk of stream) {
+                    const data = carry ? Buffer.concat([carry, chunk]) : chunk;
+                    let offset = 0;
+                    while (offset + HEADER_SIZE <= data.length) {
+                        const length = data.readUInt16LE(offset);
+                        if (length < HEADER_SIZE) {
+                            // Not a record boundary: the rest of this segment
+                            // cannot be read, go on with the next one
+                            this.log.warn(`Corrupt event history record in ${segment.file}`);
+                            break chunks;
+                        }
+                        if (offset + length > data.length) {
+                            break;
+                        }
+                        const record = decodeRecord(data, offset);
+                        offset += length;
+                        if (record.time > to) {
+                            return;
+                        }
+                        if (record.time >= from && (!deviceId || record.device === deviceId)) {
+                            yield {
+                                time: record.time,
+                                device: record.device,
+                                event: KIND_NAMES[record.kind] || String(record.kind),
+                                data: record.data
+                            };
+                            if (++count >= limit) {
+                                return;
+                            }
+                        }
+                    }
+                    carry = offset < data.length ? data.subarray(offset) : null;
+                }
+            } finally {
+                stream.destroy();
+            }
+        }
+    }
+
+    metrics() {
+        return Object.assign({
+            segments: this.segments.length,
+            bytes: this.segments.reduce((sum, segment) => sum + segment.size, 0),
+            records: this.segments.reduce((sum, segment) => sum + segment.records, 0),
+            buffered: this.buffered,
+            oldest: this.segments.length ? this.segments[0].firstTime : null
+        }, this.stats);
+    }
+}
+
+module.exports = {
+    EventHistory,
+    encodeRecord,
+    decodeRecord,
+    KIND_STATUS,
+    KIND_COMMAND,
+    KIND_ACK,
+    KIND_NACK,
+    DEFAULTS
+};
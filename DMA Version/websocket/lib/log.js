@@ -0,0 +1,65 @@
+// Leveled logging with sampling for per-message lines
+//
+// LOG_LEVEL selects error / warn / info / debug (default info). Lines that
+// would be printed for every MQTT or WebSocket message go through a
+// sampler, which prints one in every LOG_SAMPLE calls (default 100) and says
+// how many were skipped. With LOG_LEVEL=debug every line is printed.
+
+const LEVELS = { error: 0, warn: 1, info: 2, debug: 3 };
+
+const WRITERS = {
+    error: console.error,
+    warn: console.warn,
+    info: console.log,
+    debug: console.log
+};
+
+class Logger {
+    constructor(options = {}) {
+        const level = String(options.level || 'info').toLowerCase();
+        this.level = level in LEVELS ? LEVELS[level] : LEVELS.info;
+        this.sampleEvery = Math.max(1, options.sample || 1);
+    }
+
+    enabled(level) {
+        return LEVELS[level] <= this.level;
+    }
+
+    error(...args) { this.write('error', args); }
+    warn(...args) { this.write('warn', args); }
+    info(...args) { this.write('info', args); }
+    debug(...args) { this.write('debug', args); }
+
+    write(level, args) {
+        if (LEVELS[level] <= this.level) {
+            WRITERS[level](...args);
+        }
+    }
+
+    // Returns a function that logs one message in every `sampleEvery` at
+    // `level`, or all of them when debug logging is on. Arguments may be a
+    // function producing the message, so skipped lines cost no formatting.
+    sampler(level = 'info') {
+        let skipped = 0;
+        return (message) => {
+            if (!this.enabled(level)) {
+                return;
+            }
+            if (this.level < LEVELS.debug && ++skipped < this.sampleEvery) {
+                return;
+            }
+            const text = typeof message === 'function' ? message() : message;
+            WRITERS[level](skipped > 1 ? `${text} (1 of ${skipped})` : text);
+            skipped = 0;
+        };
+    }
+}
+
+function createLogger(env = process.env) {
+    return new Logger({
+        level: env.LOG_LEVEL,
+        sample: parseInt(env.LOG_SAMPLE, 10) || 100
+    });
+}
+
+module.exports = { Logger, createLogger, LEVELS };
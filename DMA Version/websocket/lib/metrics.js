@@ -0,0 +1,187 @@
+// Counters, gauges and histograms for the /metrics endpoint
+//
+// Rendered in the Prometheus text format, so the endpoint can be scraped
+// as-is or simply read with curl. Rates (messages per second) are derived
+// from the counters by the reader, e.g. rate(mqtt_messages_received_total[1m]).
+
+class Counter {
+    constructor(name, help) {
+        this.name = name;
+        this.help = help;
+        this.value = 0;
+    }
+
+    inc(amount = 1) {
+        this.value += amount;
+    }
+
+    render() {
+        return [
+            `# HELP ${this.name} ${this.help}`,
+            `# TYPE ${this.name} counter`,
+            `${this.name} ${this.value}`
+        ];
+    }
+}
+
+// Value read when the metrics are rendered (connected clients, counters
+// kept by other modules, ...)
+class Gauge {
+    constructor(name, help, read, type = 'gauge') {
+        this.name = name;
+        this.help = help;
+        this.read = read;
+        this.type = type;
+    }
+
+    render() {
+        return [
+            `# HELP ${this.name} ${this.help}`,
+            `# TYPE ${this.name} ${this.type}`,
+            `${this.name} ${this.read()}`
+        ];
+    }
+}
+
+// Fixed buckets; observe() is a short linear scan with no allocation
+class Histogram {
+    constructor(name, help, buckets) {
+        this.name = name;
+        this.help = help;
+        this.buckets = buckets.slice().sort((a, b) => a - b);
+        this.counts = new Array(this.buckets.length + 1).fill(0);
+        this.sum = 0;
+        this.count = 0;
+    }
+
+    observe(value) {
+        let i = 0;
+        while (i < this.buckets.length && value > this.buckets[i]) {
+            i++;
+        }
+        this.counts[i]++;
+        this.sum += value;
+        this.count++;
+    }
+
+    render() {
+        const lines = [
+            `# HELP ${this.name} ${this.help}`,
+            `# TYPE ${this.name} histogram`
+        ];
+        let cumulative = 0;
+        this.buckets.forEach((le, i) => {
+            cumulative += this.counts[i];
+            lines.push(`${this.name}_bucket{le="${le}"} ${cumulative}`);
+        });
+        lines.push(`${this.name}_bucket{le="+Inf"} ${this.count}`);
+        lines.push(`${this.name}_sum ${Number(this.sum.toFixed(3))}`);
+        lines.push(`${this.name}_count ${this.count}`);
+        return lines;
+    }
+}
+
+class Registry {
+    constructor() {
+        this.metrics = [];
+    }
+
+    counter(name, help) {
+        return this.register(new Counter(name, help));
+    }
+
+    gauge(name, help, read) {
+        return this.register(new Gauge(name, help, read));
+    }
+
+    // Counter whose value is kept elsewhere
+    counterFrom(name, help, read) {
+        return this.register(new Gauge(name, help, read, 'counter'));
+    }
+
+    histogram(name, help, buckets) {
+        return this.register(new Histogram(name, help, buckets));
+    }
+
+    register(metric) {
+        this.metrics.push(metric);
+        return metric;
+    }
+
+    render() {
+        const lines = [];
+        for (const metric of this.metrics) {
+            lines.push(...metric.render());
+        }
+        return lines.join('\n') + '\n';
+    }
+}
+
+// Bucket bounds in ms
+const LATENCY_BUCKETS = [1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000];
+const FAST_BUCKETS = [0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100];
+
+// Sample event-loop lag: how late a timer fires compared to when it was due
+function monitorEventLoop(histogram, interval = 500) {
+    let expected = Date.now() + interval;
+    const timer = setInterval(() => {
+        const now = Date.now();
+        histogram.observe(Math.max(0, now - expected));
+        expected = now + interval;
+    }, interval);
+    timer.unref();
+    return timer;
+}
+
+// Combine the pages rendered by several processes (cluster mode) into one:
+// samples with the same name and labels are added up, so counters and
+// histograms cover every process and gauges such as heap are totals
+function mergeRendered(pages) {
+    const lines = [];
+    const sums = new Map();     // "name{labels}" -> index into lines
+
+    for (const page of pages) {
+        for (const line of page.split('\n')) {
+            if (line === '') {
+                continue;
+            }
+            if (line.startsWith('#')) {
+                if (!sums.has(line)) {
+                    sums.set(line, -1);
+                    lines.push(line);
+                }
+                continue;
+            }
+            const space = line.lastIndexOf(' ');
+            const series = line.slice(0, space);
+            const value = Number(line.slice(space + 1));
+            const index = sums.get(series);
+            if (index === undefined) {
+                sums.set(series, lines.length);
+                lines.push([series, value]);
+            } else {
+                lines[index][1] += value;
+            }
+        }
+    }
+    return lines.map((line) => (typeof line === 'string'
+        ? line
+        : `${line[0]} ${Number.isInteger(line[1]) ? line[1] : Number(line[1].toFixed(3))}`)).join('\n') + '\n';
+}
+
+// Milliseconds elapsed since a process.hrtime.bigint() timestamp
+function elapsedMs(start) {
+    return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+module.exports = {
+    Registry,
+    Counter,
+    Gauge,
+    Histogram,
+    LATENCY_BUCKETS,
+    FAST_BUCKETS,
+    monitorEventLoop,
+    mergeRendered,
+    elapsedMs
+};
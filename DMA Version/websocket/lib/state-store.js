@@ -0,0 +1,186 @@
+// Device state persisted across server restarts
+//
+// The file holds one JSON line per record, { id, state, seq, updatedAt },
+// plus whatever the `extra` option returns for the device (the command
+// tracker's sequence state); when a device appears more than once the last
+// line wins. Updates are not written one by one: changed devices are
+// collected and appended in one write every `flushInterval` ms, so a burst
+// of status messages costs a single append. Once the file has grown to
+// `compactAfter` lines beyond one per device, it is rewritten with just the
+// latest state of each device (temporary file + rename, so a crash leaves
+// either the old or the new file). A torn last line from a crash during an
+// append is ignored on load.
+
+const fs = require('fs');
+const path = require('path');
+const { createLogger } = require('./log');
+
+const DEFAULTS = {
+    flushInterval: 1000,    // ms between appends of changed devices
+    compactAfter: 10000,    // extra lines tolerated before rewriting the file
+    extra: () => null,      // (device id) -> more fields to save with the device
+    log: null               // Logger (lib/log.js); null: one set up from the environment
+};
+
+class StateStore {
+    // snapshot() returns the current state of every device, for compaction
+    constructor(file, snapshot, options = {}) {
+        this.file = file;
+        this.snapshot = snapshot;
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.log = this.opts.log || createLogger();
+        this.dirty = new Map();     // device id -> entry waiting to be written
+        this.lines = 0;
+        this.writing = false;
+        this.timer = null;
+        this.stats = { loaded: 0, appended: 0, compactions: 0, errors: 0 };
+    }
+
+    serialize(device) {
+        return JSON.stringify(Object.assign({
+            id: device.id,
+            state: device.state,
+            seq: device.seq,
+            updatedAt: device.updatedAt
+        }, this.opts.extra(device.id))) + '\n';
+    }
+
+    // Read the saved states; returns [] if there is no file yet
+    load() {
+        let text;
+        try {
+            text = fs.readFileSync(this.file, 'utf8');
+        } catch (error) {
+            if (error.code !== 'ENOENT') {
+                this.log.warn(`Cannot read state file ${this.file}: ${error.message}`);
+            }
+            return [];
+        }
+
+        const latest = new Map();
+        for (const line of text.split('\n')) {
+            if (!line) {
+                continue;
+            }
+            try {
+                const entry = JSON.parse(line);
+                if (typeof entry.id === 'string') {
+                    latest.set(entry.id, entry);
+                }
+            } catch (error) {
+                // Torn line from an interrupted append
+            }
+            this.lines++;
+        }
+        this.stats.loaded = latest.size;
+        return Array.from(latest.values());
+    }
+
+    // Remember that a device changed; it is written with the next flush
+    record(device) {
+        this.dirty.set(device.id, device);
+        this.schedule();
+    }
+
+    schedule() {
+        if (!this.timer) {
+            this.timer = setTimeout(() => {
+                this.timer = null;
+                this.flush();
+            }, this.opts.flushInterval);
+        }
+    }
+
+    takeDirty() {
+        const text = Array.from(this.dirty.values(), (device) => this.serialize(device)).join('');
+        const count = this.dirty.size;
+        this.dirty.clear();
+        return { text, count };
+    }
+
+    needsCompaction() {
+        return this.lines > this.snapshot().length + this.opts.compactAfter;
+    }
+
+    // Append the changed devices (or rewrite the file when it has grown)
+    flush() {
+        if (this.writing || this.dirty.size === 0) {
+            return;
+        }
+        this.writing = true;
+        const done = (error) => {
+            this.writing = false;
+            if (error) {
+                this.stats.errors++;
+                this.log.warn(`Cannot write state file ${this.file}: ${error.message}`);
+            }
+            // Changes that came in while writing
+            if (this.dirty.size > 0) {
+                this.schedule();
+            }
+        };
+
+        if (this.needsCompaction()) {
+            this.dirty.clear();
+            this.compact(done);
+            return;
+        }
+        const { text, count } = this.takeDirty();
+        fs.mkdir(path.dirname(this.file), { recursive: true }, () => {
+            fs.appendFile(this.file, text, (error) => {
+                if (!error) {
+                    this.lines += count;
+                    this.stats.appended += count;
+                }
+                done(error);
+            });
+        });
+    }
+
+    // Rewrite the file with one line per device
+    compact(callback) {
+        const devices = this.snapshot();
+        const text = devices.map((device) => this.serialize(device)).join('');
+        const temp = `${this.file}.tmp`;
+
+        fs.writeFile(temp, text, (error) => {
+            if (error) {
+                callback(error);
+                return;
+            }
+            fs.rename(temp, this.file, (renameError) => {
+                if (!renameError) {
+                    this.lines = devices.length;
+                    this.stats.compactions++;
+                }
+                callback(renameError);
+            });
+        });
+    }
+
+    // Write the full state before the process exits. Rewrites the file
+    // rather than appending, so an append or compaction still in flight
+    // cannot lose the last changes.
+    flushSync() {
+        clearTimeout(this.timer);
+        this.timer = null;
+        if (this.dirty.size === 0 && !this.writing) {
+            return;
+        }
+        this.dirty.clear();
+        try {
+            const temp = `${this.file}.tmp`;
+            fs.mkdirSync(path.dirname(this.file), { recursive: true });
+            fs.writeFileSync(temp, this.snapshot().map((device) => this.serialize(device)).join(''));
+            fs.renameSync(temp, this.file);
+        } catch (error) {
+            this.log.warn(`Cannot write state file ${this.file}: ${error.message}`);
+        }
+    }
+
+    metrics() {
+        return Object.assign({ file: this.file, lines: this.lines, pending: this.dirty.size }, this.stats);
+    }
+}
+
+module.exports = { StateStore, DEFAULTS };
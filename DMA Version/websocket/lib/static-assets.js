@@ -0,0 +1,179 @@
+// Static files served from memory, precompressed
+//
+// Every file in the public folder is read once at startup and compressed
+// with brotli and gzip (best settings, since it only happens once). Requests
+// get the smallest encoding the browser accepts, with Content-Length and a
+// strong ETag per encoding, so a reload costs a 304 with no body.
+//
+// Assets referenced by an HTML page (src="protocol.js") are also served
+// under a versioned name containing their hash (protocol.3fa9c2d1.js), and
+// the page is rewritten to use it. Versioned URLs never change content, so
+// they are cached as immutable and not even revalidated; pages and plain
+// names are revalidated on every load (no-cache + ETag).
+
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+const crypto = require('crypto');
+
+const CONTENT_TYPES = {
+    '.html': 'text/html; charset=utf-8',
+    '.js': 'application/javascript; charset=utf-8',
+    '.css': 'text/css; charset=utf-8',
+    '.json': 'application/json; charset=utf-8',
+    '.svg': 'image/svg+xml',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon'
+};
+
+// Already-compressed formats are not worth another pass
+const COMPRESSIBLE = new Set(['.html', '.js', '.css', '.json', '.svg']);
+
+const CACHE_REVALIDATE = 'no-cache';
+const CACHE_IMMUTABLE = 'public, max-age=31536000, immutable';
+
+function hash(data) {
+    return crypto.createHash('sha256').update(data).digest('hex');
+}
+
+// One encoding of a file: body plus its ETag
+function variant(body, tag, encoding) {
+    return { body, encoding, etag: `"${tag}${encoding ? `-${encoding}` : ''}"` };
+}
+
+class StaticAssets {
+    constructor(dir) {
+        this.dir = dir;
+        this.files = new Map();     // URL path -> { type, cacheControl, variants: { br, gzip, identity } }
+        this.stats = { requests: 0, notModified: 0, bytesSent: 0, bytesUncompressed: 0 };
+    }
+
+    load() {
+        const names = fs.readdirSync(this.dir).filter((name) => fs.statSync(path.join(this.dir, name)).isFile());
+        const versioned = new Map();    // file name -> versioned name
+
+        // Plain assets first, so pages can point at their versioned names
+        for (const name of names.filter((n) => path.extname(n) !== '.html')) {
+            const data = fs.readFileSync(path.join(this.dir, name));
+            const tag = hash(data).slice(0, 16);
+            const ext = path.extname(name);
+            const versionedName = `${path.basename(name, ext)}.${tag.slice(0, 8)}${ext}`;
+            versioned.set(name, versionedName);
+            this.add(`/${name}`, ext, data, tag, CACHE_REVALIDATE);
+            this.add(`/${versionedName}`, ext, data, tag, CACHE_IMMUTABLE);
+        }
+        for (const name of names.filter((n) => path.extname(n) === '.html')) {
+            const html = fs.readFileSync(path.join(this.dir, name), 'utf8')
+                .replace(/\b(src|href)="([^"/:?#]+)"/g, (match, attr, file) =>
+                    (versioned.has(file) ? `${attr}="${versioned.get(file)}"` : match));
+            const data = Buffer.from(html);
+            this.add(`/${name}`, '.html', data, hash(data).slice(0, 16), CACHE_REVALIDATE);
+        }
+        if (this.files.has('/index.html')) {
+            this.files.set('/', this.files.get('/index.html'));
+        }
+        return this;
+    }
+
+    add(urlPath, ext, data, tag, cacheControl) {
+        const variants = { identity: variant(data, tag, null) };
+        if (COMPRESSIBLE.has(ext)) {
+            const br = zlib.brotliCompressSync(data, {
+                params: {
+                    [zlib.constants.BROTLI_PARAM_QUALITY]: zlib.constants.BROTLI_MAX_QUALITY,
+                    [zlib.constants.BROTLI_PARAM_SIZE_HINT]: data.length
+                }
+            });
+            const gzip = zlib.gzipSync(data, { level: zlib.constants.Z_BEST_COMPRESSION });
+            if (br.length < data.length) {
+                variants.br = variant(br, tag, 'br');
+            }
+            if (gzip.length < data.length) {
+                variants.gzip = variant(gzip, tag, 'gzip');
+            }
+        }
+        this.files.set(urlPath, {
+            type: CONTENT_TYPES[ext] || 'application/octet-stream',
+            cacheControl,
+            size: data.length,
+            variants
+        });
+    }
+
+    // Best encoding the request accepts: br, then gzip, then identity
+    static negotiate(file, acceptEncoding = '') {
+        const accepted = new Set();
+        for (const part of acceptEncoding.split(',')) {
+            const [coding, ...params] = part.trim().toLowerCase().split(';');
+            if (!params.some((p) => /^\s*q=0(\.0*)?\s*$/.test(p))) {
+                accepted.add(coding);
+            }
+        }
+        if (file.variants.br && (accepted.has('br') || accepted.has('*'))) {
+            return file.variants.br;
+        }
+        if (file.variants.gzip && (accepted.has('gzip') || accepted.has('*'))) {
+            return file.variants.gzip;
+        }
+        return file.variants.identity;
+    }
+
+    // Express middleware; passes on anything it does not hold
+    middleware() {
+        return (req, res, next) => {
+            if (req.method !== 'GET' && req.method !== 'HEAD') {
+                next();
+                return;
+            }
+            const file = this.files.get(req.url.split('?')[0]);
+            if (!file) {
+                next();
+                return;
+            }
+            const chosen = StaticAssets.negotiate(file, req.headers['accept-encoding']);
+            this.stats.requests++;
+
+            res.setHeader('Content-Type', file.type);
+            res.setHeader('Cache-Control', file.cacheControl);
+            res.setHeader('ETag', chosen.etag);
+            res.setHeader('Vary', 'Accept-Encoding');
+
+            const ifNoneMatch = req.headers['if-none-match'];
+            if (ifNoneMatch && ifNoneMatch.split(',').some((tag) => tag.trim().replace(/^W\//, '') === chosen.etag)) {
+                this.stats.notModified++;
+                res.statusCode = 304;
+                res.end();
+                return;
+            }
+            if (chosen.encoding) {
+                res.setHeader('Content-Encoding', chosen.encoding);
+            }
+            res.setHeader('Content-Length', chosen.body.length);
+            if (req.method === 'HEAD') {
+                res.end();
+                return;
+            }
+            this.stats.bytesSent += chosen.body.length;
+            this.stats.bytesUncompressed += file.size;
+            res.end(chosen.body);
+        };
+    }
+
+    // Sizes per file and encoding
+    metrics() {
+        const files = {};
+        for (const [urlPath, file] of this.files) {
+            if (urlPath !== '/') {
+                files[urlPath] = {
+                    identity: file.size,
+                    gzip: file.variants.gzip ? file.variants.gzip.body.length : null,
+                    br: file.variants.br ? file.variants.br.body.length : null,
+                    cache: file.cacheControl
+                };
+            }
+        }
+        return Object.assign({ files }, this.stats);
+    }
+}
+
+module.exports = { StaticAssets, CACHE_IMMUTABLE, CACHE_REVALIDATE };
@@ -0,0 +1,273 @@
+// Virtualized grid of devices for the dashboard
+//
+// Only the rows in view (plus a few above and below) exist in the DOM, so
+// the cost of the grid does not depend on the size of the fleet. The cells
+// are a fixed pool, absolutely positioned inside a spacer as tall as the
+// whole grid. Device index i is always drawn by cell i % pool size: when
+// the view scrolls by one row, only the cells of that row move to the other
+// end and get a new device; the rest are left alone.
+//
+// A status update changes states[i] and, if device i is in view, marks it
+// dirty; render() (once per animation frame, driven by the page) repaints
+// just the dirty cells, and only what changed in them (the LED class). New
+// devices are collected and merged, re-sorted, in the next render.
+//
+//   const grid = new DeviceGrid(element, { parse, onSelect, requestFrame, onViewport });
+//   grid.setDevices([{ id, state }, ...]);   // full snapshot
+//   grid.update(id, state);                  // one status
+//   grid.render();                           // in requestAnimationFrame
+
+(function (root, factory) {
+    if (typeof module === 'object' && module.exports) {
+        module.exports = factory();
+    } else {
+        root.DeviceGrid = factory();
+    }
+}(typeof self !== 'undefined' ? self : this, function () {
+    const DEFAULTS = {
+        cellWidth: 150,         // px, columns = floor(width / cellWidth)
+        rowHeight: 32,          // px
+        overscan: 4,            // rows kept beyond each edge of the view
+        viewportDelay: 150,     // ms after scrolling stops before onViewport
+        parse: (state) => state,            // state text -> 'on' / 'off' / 'unknown'
+        onSelect: () => {},                 // (device id) cell clicked
+        requestFrame: null,                 // () asks for a render() soon
+        onViewport: () => {}                // devices in view changed
+    };
+
+    const LED_CLASS = {
+        on: 'grid-led led-on',
+        off: 'grid-led led-off',
+        unknown: 'grid-led'
+    };
+
+    class DeviceGrid {
+        constructor(element, options) {
+            this.el = element;
+            this.opts = Object.assign({}, DEFAULTS, options);
+            this.ids = [];                  // sorted device IDs
+            this.index = new Map();         // device ID -> position in ids
+            this.states = [];               // parsed state per position
+            this.added = new Map();         // unknown device ID -> state, merged in render()
+            this.dirty = new Set();         // positions to repaint
+            this.cells = [];                // the pool
+            this.columns = 1;
+            this.firstIndex = 0;            // first position drawn
+            this.layoutDirty = true;
+            this.selected = null;
+            this.viewportTimer = null;
+            this.stats = { renders: 0, cellsPainted: 0, cellsMoved: 0 };
+
+            this.spacer = document.createElement('div');
+            this.spacer.className = 'grid-spacer';
+            this.el.appendChild(this.spacer);
+
+            this.el.addEventListener('scroll', () => this.requestRender(), { passive: true });
+            window.addEventListener('resize', () => {
+                this.layoutDirty = true;
+                this.requestRender();
+            });
+            this.el.addEventListener('click', (event) => {
+                const cell = event.target.closest('.grid-cell');
+                if (cell && this.ids[cell.gridIndex] !== undefined) {
+                    this.opts.onSelect(this.ids[cell.gridIndex]);
+                }
+            });
+        }
+
+        requestRender() {
+            if (this.opts.requestFrame) {
+                this.opts.requestFrame();
+            } else {
+                requestAnimationFrame(() => this.render());
+            }
+        }
+
+        // Replace every device (full snapshot)
+        setDevices(devices) {
+            this.ids = devices.map((device) => device.id).sort();
+            const byId = new Map(devices.map((device) => [device.id, device.state]));
+            this.states = this.ids.map((id) => this.opts.parse(byId.get(id)));
+            this.reindex();
+            this.added.clear();
+            this.layoutDirty = true;
+            this.requestRender();
+        }
+
+        update(id, state) {
+            const i = this.index.get(id);
+            if (i === undefined) {
+                this.added.set(id, state);
+                this.layoutDirty = true;
+                this.requestRender();
+                return;
+            }
+            const parsed = this.opts.parse(state);
+            if (this.states[i] !== parsed) {
+                this.states[i] = parsed;
+                if (this.isDrawn(i)) {
+                    this.dirty.add(i);
+                    this.requestRender();
+                }
+            }
+        }
+
+        select(id) {
+            const previous = this.index.get(this.selected);
+            this.selected = id;
+            for (const i of [previous, this.index.get(id)]) {
+                if (i !== undefined && this.isDrawn(i)) {
+                    this.dirty.add(i);
+                }
+            }
+            this.requestRender();
+        }
+
+        // Device IDs of the rows drawn (in view plus overscan)
+        visibleIds() {
+            const end = Math.min(this.ids.length, this.firstIndex + this.cells.length);
+            return this.ids.slice(this.firstIndex, end);
+        }
+
+        isDrawn(i) {
+            return i >= this.firstIndex && i < this.firstIndex + this.cells.length;
+        }
+
+        reindex() {
+            this.index.clear();
+            this.ids.forEach((id, i) => this.index.set(id, i));
+        }
+
+        // Fold the devices seen since the last render into the sorted list
+        mergeAdded() {
+            const states = new Map(this.ids.map((id, i) => [id, this.states[i]]));
+            for (const [id, state] of this.added) {
+                states.set(id, this.opts.parse(state));
+            }
+            this.added.clear();
+            this.ids = Array.from(states.keys()).sort();
+            this.states = this.ids.map((id) => states.get(id));
+            this.reindex();
+        }
+
+        render() {
+            this.stats.renders++;
+            if (this.added.size > 0) {
+                this.mergeAdded();
+            }
+
+            const { rowHeight, cellWidth, overscan } = this.opts;
+            const columns = Math.max(1, Math.floor(this.el.clientWidth / cellWidth));
+            const rowsInView = Math.ceil(this.el.clientHeight / rowHeight) + 1;
+            const poolSize = (rowsInView + 2 * overscan) * columns;
+            const firstRow = Math.max(0, Math.floor(this.el.scrollTop / rowHeight) - overscan);
+            const firstIndex = firstRow * columns;
+
+            if (this.layoutDirty || columns !== this.columns || poolSize !== this.cells.length) {
+                this.layoutDirty = false;
+                this.columns = columns;
+                this.spacer.style.height = `${Math.ceil(this.ids.length / columns) * rowHeight}px`;
+                this.resizePool(poolSize);
+                this.firstIndex = firstIndex;
+                this.cells.forEach((cell) => {
+                    cell.gridIndex = -1;
+                });
+                this.paintRange(firstIndex, firstIndex + poolSize);
+                this.viewportChanged();
+            } else if (firstIndex !== this.firstIndex) {
+                // Scrolled: only positions that entered the view need a cell
+                const oldFirst = this.firstIndex;
+                this.firstIndex = firstIndex;
+                if (firstIndex > oldFirst) {
+                    this.paintRange(Math.max(oldFirst + poolSize, firstIndex), firstIndex + poolSize);
+                } else {
+                    this.paintRange(firstIndex, Math.min(oldFirst, firstIndex + poolSize));
+                }
+                this.viewportChanged();
+            }
+
+            for (const i of this.dirty) {
+                if (this.isDrawn(i)) {
+                    this.paint(i);
+                }
+            }
+            this.dirty.clear();
+        }
+
+        resizePool(size) {
+            while (this.cells.length < size) {
+                const cell = document.createElement('div');
+                cell.className = 'grid-cell';
+                cell.led = document.createElement('span');
+                cell.label = document.createElement('span');
+                cell.label.className = 'grid-id';
+                cell.appendChild(cell.led);
+                cell.appendChild(cell.label);
+                cell.gridIndex = -1;
+                cell.ledClass = null;
+                cell.isSelected = false;
+                cell.isHidden = false;
+                this.el.appendChild(cell);
+                this.cells.push(cell);
+            }
+            while (this.cells.length > size) {
+                this.el.removeChild(this.cells.pop());
+            }
+        }
+
+        paintRange(from, to) {
+            for (let i = from; i < to; i++) {
+                this.paint(i);
+            }
+        }
+
+        // Draw position i in its cell, touching only what differs
+        paint(i) {
+            const cell = this.cells[i % this.cells.length];
+            if (i >= this.ids.length) {
+                cell.gridIndex = -1;
+                if (!cell.isHidden) {
+                    cell.isHidden = true;
+                    cell.style.display = 'none';
+                }
+                return;
+            }
+            this.stats.cellsPainted++;
+            if (cell.isHidden) {
+                cell.isHidden = false;
+                cell.style.display = '';
+            }
+            if (cell.gridIndex !== i) {
+                cell.gridIndex = i;
+                cell.label.textContent = this.ids[i];
+                const row = Math.floor(i / this.columns);
+                const column = i % this.columns;
+                cell.style.transform = `translate(${column * this.opts.cellWidth}px, ${row * this.opts.rowHeight}px)`;
+                this.stats.cellsMoved++;
+            }
+            const ledClass = LED_CLASS[this.states[i]] || LED_CLASS.unknown;
+            if (cell.ledClass !== ledClass) {
+                cell.ledClass = ledClass;
+                cell.led.className = ledClass;
+            }
+            const isSelected = this.ids[i] === this.selected;
+            if (cell.isSelected !== isSelected) {
+                cell.isSelected = isSelected;
+                cell.classList.toggle('selected', isSelected);
+            }
+        }
+
+        // Tell the page once scrolling has settled (it re-subscribes)
+        viewportChanged() {
+            clearTimeout(this.viewportTimer);
+            this.viewportTimer = setTimeout(() => this.opts.onViewport(), this.opts.viewportDelay);
+        }
+
+        metrics() {
+            return Object.assign({ devices: this.ids.length, cells: this.cells.length }, this.stats);
+        }
+    }
+
+    DeviceGrid.DEFAULTS = DEFAULTS;
+    return DeviceGrid;
+}));
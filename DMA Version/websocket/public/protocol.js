@@ -0,0 +1,248 @@
+// Binary WebSocket protocol for LED state, shared by server.js and the dashboard
+//
+// The browser offers both subprotocols when connecting:
+//
+//   new WebSocket(url, [BINARY_PROTOCOL, JSON_PROTOCOL])
+//
+// and the server picks the binary one when it is offered. Clients that ask for
+// JSON, or for no subprotocol at all, keep receiving the JSON messages. Only
+// the hot messages (LED state, snapshots, control) have a binary form; acks,
+// errors and subscriptions are always JSON text frames.
+//
+// Frame (little endian):
+//
+//   0  u8   version (1)
+//   1  u8   type (TYPE_*)
+//   2  u16  record count
+//   4  records, RECORD_SIZE bytes each:
+//      0   24 bytes  device ID, ASCII, NUL padded
+//      24  u8        state (STATE_*)
+//      25  3 bytes   reserved (0)
+//      28  u32       sequence number (per-device update counter; the
+//                    command ID for control frames)
+//      32  f64       timestamp, ms since the epoch
+//
+// Messages that cannot be represented (e.g. a device ID longer than 24
+// characters) are sent as JSON instead.
+
+(function (root, factory) {
+    if (typeof module === 'object' && module.exports) {
+        module.exports = factory();
+    } else {
+        root.LedProtocol = factory();
+    }
+}(typeof self !== 'undefined' ? self : this, function () {
+    const VERSION = 1;
+    const BINARY_PROTOCOL = 'led.v1.binary';
+    const JSON_PROTOCOL = 'led.v1.json';
+
+    const TYPE_STATE = 1;
+    const TYPE_SNAPSHOT = 2;
+    const TYPE_PARTIAL_SNAPSHOT = 3;
+    const TYPE_CONTROL = 4;
+
+    const STATE_UNKNOWN = 0;
+    const STATE_OFF = 1;
+    const STATE_ON = 2;
+
+    const HEADER_SIZE = 4;
+    const RECORD_SIZE = 40;
+    const ID_SIZE = 24;
+    const MAX_RECORDS = 0xFFFF;
+
+    const STATE_TEXT = ['unknown', 'LED: OFF', 'LED: ON'];
+
+    // "STM32 Connected - LED: ON" -> STATE_ON
+    function stateCode(text) {
+        if (text === 'LED: ON') {
+            return STATE_ON;
+        }
+        if (text === 'LED: OFF') {
+            return STATE_OFF;
+        }
+        const match = /LED:\s*(ON|OFF)/i.exec(text || '');
+        if (!match) {
+            return STATE_UNKNOWN;
+        }
+        return match[1].toUpperCase() === 'ON' ? STATE_ON : STATE_OFF;
+    }
+
+    function stateText(code) {
+        return STATE_TEXT[code] || STATE_TEXT[STATE_UNKNOWN];
+    }
+
+    function canEncodeId(id) {
+        if (typeof id !== 'string' || id.length === 0 || id.length > ID_SIZE) {
+            return false;
+        }
+        for (let i = 0; i < id.length; i++) {
+            const c = id.charCodeAt(i);
+            if (c === 0 || c > 0x7F) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    function header(type, count) {
+        const bytes = new Uint8Array(HEADER_SIZE + count * RECORD_SIZE);
+        const view = new DataView(bytes.buffer);
+        view.setUint8(0, VERSION);
+        view.setUint8(1, type);
+        view.setUint16(2, count, true);
+        return { bytes, view };
+    }
+
+    function writeRecord(bytes, view, offset, id, state, seq, time) {
+        for (let i = 0; i < id.length; i++) {
+            bytes[offset + i] = id.charCodeAt(i);
+        }
+        view.setUint8(offset + 24, state);
+        view.setUint32(offset + 28, (seq || 0) >>> 0, true);
+        view.setFloat64(offset + 32, time || 0, true);
+    }
+
+    // A frame with a single record (state updates, control)
+    function encodeOne(type, id, state, seq, time) {
+        if (!canEncodeId(id)) {
+            return null;
+        }
+        const { bytes, view } = header(type, 1);
+        writeRecord(bytes, view, HEADER_SIZE, id, state, seq, time);
+        return bytes;
+    }
+
+    // records: [{ id, state (STATE_*), seq, time }]. Returns a Uint8Array, or
+    // null if a record cannot be represented.
+    function encode(type, records) {
+        if (records.length > MAX_RECORDS || !records.every((record) => canEncodeId(record.id))) {
+            return null;
+        }
+        const { bytes, view } = header(type, records.length);
+        records.forEach((record, i) => {
+            writeRecord(bytes, view, HEADER_SIZE + i * RECORD_SIZE, record.id, record.state, record.seq, record.time);
+        });
+        return bytes;
+    }
+
+    // Binary form of a JSON-shaped message, or null if it has none
+    function encodeMessage(message) {
+        const deviceRecord = (device) => ({
+            id: device.id,
+            state: stateCode(device.state),
+            seq: device.seq,
+            time: device.updatedAt
+        });
+
+        switch (message.type) {
+            case 'led_state':
+                return encodeOne(TYPE_STATE, message.device, stateCode(message.state), message.seq, message.updatedAt);
+            case 'snapshot':
+                return encode(message.partial ? TYPE_PARTIAL_SNAPSHOT : TYPE_SNAPSHOT,
+                    message.devices.map(deviceRecord));
+            case 'control':
+                if (message.state !== 'on' && message.state !== 'off') {
+                    return null;
+                }
+                return encodeOne(TYPE_CONTROL, message.device,
+                    message.state === 'on' ? STATE_ON : STATE_OFF, message.id, Date.now());
+            default:
+                return null;
+        }
+    }
+
+    function readId(bytes, offset) {
+        let id = '';
+        for (let i = offset; i < offset + ID_SIZE && bytes[i] !== 0; i++) {
+            id += String.fromCharCode(bytes[i]);
+        }
+        return id;
+    }
+
+    function readRecord(bytes, view, offset) {
+        return {
+            id: readId(bytes, offset),
+            state: view.getUint8(offset + 24),
+            seq: view.getUint32(offset + 28, true),
+            time: view.getFloat64(offset + 32, true)
+        };
+    }
+
+    // Decode a frame (ArrayBuffer, Uint8Array or Buffer) into the same shape
+    // as the JSON message. Throws on a malformed frame.
+    function decode(data) {
+        const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+        const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+        if (bytes.byteLength < HEADER_SIZE || view.getUint8(0) !== VERSION) {
+            throw new Error('unsupported frame version');
+        }
+        const type = view.getUint8(1);
+        const count = view.getUint16(2, true);
+        if (bytes.byteLength < HEADER_SIZE + count * RECORD_SIZE) {
+            throw new Error('truncated frame');
+        }
+
+        if (type === TYPE_STATE && count === 1) {
+            // Hot path: one state update
+            return {
+                type: 'led_state',
+                device: readId(bytes, HEADER_SIZE),
+                state: stateText(view.getUint8(HEADER_SIZE + 24)),
+                seq: view.getUint32(HEADER_SIZE + 28, true),
+                updatedAt: view.getFloat64(HEADER_SIZE + 32, true)
+            };
+        }
+
+        const records = [];
+        for (let i = 0; i < count; i++) {
+            records.push(readRecord(bytes, view, HEADER_SIZE + i * RECORD_SIZE));
+        }
+
+        switch (type) {
+            case TYPE_STATE:
+                throw new Error('state frame must hold one record');
+            case TYPE_SNAPSHOT:
+            case TYPE_PARTIAL_SNAPSHOT: {
+                const message = {
+                    type: 'snapshot',
+                    devices: records.map((r) => ({ id: r.id, state: stateText(r.state), seq: r.seq, updatedAt: r.time }))
+                };
+                if (type === TYPE_PARTIAL_SNAPSHOT) {
+                    message.partial = true;
+                }
+                return message;
+            }
+            case TYPE_CONTROL: {
+                const r = records[0];
+                if (!r || (r.state !== STATE_ON && r.state !== STATE_OFF)) {
+                    throw new Error('control frame without a valid state');
+                }
+                return { type: 'control', device: r.id, state: r.state === STATE_ON ? 'on' : 'off', id: r.seq };
+            }
+            default:
+                throw new Error(`unknown frame type ${type}`);
+        }
+    }
+
+    return {
+        VERSION,
+        BINARY_PROTOCOL,
+        JSON_PROTOCOL,
+        PROTOCOLS: [BINARY_PROTOCOL, JSON_PROTOCOL],
+        TYPE_STATE,
+        TYPE_SNAPSHOT,
+        TYPE_PARTIAL_SNAPSHOT,
+        TYPE_CONTROL,
+        STATE_UNKNOWN,
+        STATE_OFF,
+        STATE_ON,
+        HEADER_SIZE,
+        RECORD_SIZE,
+        ID_SIZE,
+        stateCode,
+        stateText,
+        encode,
+        encodeMessage,
+        decode
+    };
+}));
@@ -0,0 +1,146 @@
+// WebSocket that reconnects by itself, shared by the dashboard and the benches
+//
+// After the connection drops (server restart, WiFi blip, laptop waking up)
+// a new one is opened after a random delay between 0 and
+//
+//   min(maxDelay, baseDelay * 2^attempt)
+//
+// ("full jitter"). The random part matters as much as the exponential one:
+// when a restarted server comes back, its clients return spread over the
+// whole window instead of all in the same few milliseconds. The attempt
+// counter is reset once a connection has stayed open for stableAfter ms, so
+// a server that accepts and immediately drops connections still backs off.
+//
+// The page keeps using the object like a WebSocket (send, protocol,
+// readyState) and sets onopen / onmessage / onclose once; they are called for
+// every underlying connection. url may be a function, evaluated on each
+// attempt, so the page can put its current subscriptions in it.
+
+(function (root, factory) {
+    if (typeof module === 'object' && module.exports) {
+        module.exports = factory();
+    } else {
+        root.ReconnectingSocket = factory();
+    }
+}(typeof self !== 'undefined' ? self : this, function () {
+    const DEFAULTS = {
+        baseDelay: 500,         // ms, upper bound of the first retry delay
+        maxDelay: 10000,        // ms, cap of the retry window
+        stableAfter: 5000,      // ms open before the backoff starts over
+        jitter: true,           // false: wait the full window (for comparison)
+        binaryType: 'arraybuffer',
+        WebSocket: typeof WebSocket !== 'undefined' ? WebSocket : null,
+        random: Math.random
+    };
+
+    const OPEN = 1;
+
+    class ReconnectingSocket {
+        constructor(url, protocols, options) {
+            this.url = url;
+            this.protocols = protocols;
+            this.opts = Object.assign({}, DEFAULTS, options);
+            this.ws = null;
+            this.attempt = 0;
+            this.timer = null;
+            this.stableTimer = null;
+            this.closed = false;
+            this.onopen = null;
+            this.onmessage = null;
+            this.onclose = null;
+            this.onreconnecting = null;     // (delay ms, attempt)
+            this.stats = { connects: 0, disconnects: 0 };
+            this.connect();
+        }
+
+        get readyState() {
+            return this.ws ? this.ws.readyState : 3;
+        }
+
+        get protocol() {
+            return this.ws ? this.ws.protocol : '';
+        }
+
+        connect() {
+            this.timer = null;
+            const url = typeof this.url === 'function' ? this.url() : this.url;
+            const ws = new this.opts.WebSocket(url, this.protocols);
+            ws.binaryType = this.opts.binaryType;
+            this.ws = ws;
+
+            ws.onopen = (event) => {
+                this.stats.connects++;
+                this.stableTimer = setTimeout(() => {
+                    this.attempt = 0;
+                }, this.opts.stableAfter);
+                if (this.onopen) {
+                    this.onopen(event);
+                }
+            };
+            ws.onmessage = (event) => {
+                if (this.onmessage) {
+                    this.onmessage(event);
+                }
+            };
+            // An error is always followed by close, which does the retrying
+            ws.onerror = () => {};
+            ws.onclose = (event) => {
+                clearTimeout(this.stableTimer);
+                if (ws !== this.ws) {
+                    return;
+                }
+                this.stats.disconnects++;
+                if (this.onclose) {
+                    this.onclose(event);
+                }
+                if (!this.closed) {
+                    this.schedule();
+                }
+            };
+        }
+
+        // Delay before the next attempt: random in [0, window)
+        nextDelay() {
+            const window = Math.min(this.opts.maxDelay, this.opts.baseDelay * Math.pow(2, this.attempt));
+            return this.opts.jitter ? Math.floor(this.opts.random() * window) : window;
+        }
+
+        schedule() {
+            const delay = this.nextDelay();
+            this.attempt++;
+            if (this.onreconnecting) {
+                this.onreconnecting(delay, this.attempt);
+            }
+            this.timer = setTimeout(() => this.connect(), delay);
+        }
+
+        // Retry now instead of waiting out the backoff (e.g. the browser
+        // reports it is back online)
+        reconnectNow() {
+            if (this.timer !== null && !this.closed) {
+                clearTimeout(this.timer);
+                this.connect();
+            }
+        }
+
+        send(data) {
+            if (this.ws && this.ws.readyState === OPEN) {
+                this.ws.send(data);
+                return true;
+            }
+            return false;
+        }
+
+        close() {
+            this.closed = true;
+            clearTimeout(this.timer);
+            clearTimeout(this.stableTimer);
+            if (this.ws) {
+                this.ws.close();
+            }
+        }
+    }
+
+    ReconnectingSocket.DEFAULTS = DEFAULTS;
+    return ReconnectingSocket;
+}));
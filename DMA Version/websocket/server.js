@@ -2,102 +2,733 @@ const express = require('express');
 const WebSocket = require('ws');
 const mqtt = require('mqtt');
 const path = require('path');
+const cluster = require('cluster');
+const { Broadcaster, ALL_DEVICES } = require('./lib/broadcast');
+const {
+    DeviceRegistry,
+    parseTopic,
+    deviceTopic,
+    isValidDeviceId,
+    TOPIC_CONTROL,
+    TOPIC_STATUS,
+    TOPIC_STATUS_REQUEST,
+    STATUS_SUBSCRIPTIONS
+} = require('./lib/devices');
+const { startEmbeddedBroker } = require('./lib/embedded-broker');
+const { CommandTracker, parseStatus } = require('./lib/commands');
+const { Heartbeat } = require('./lib/heartbeat');
+const protocol = require('./public/protocol');
+const { StateStore } = require('./lib/state-store');
+const {
+    EventHistory,
+    KIND_STATUS,
+    KIND_COMMAND,
+    KIND_ACK,
+    KIND_NACK
+} = require('./lib/history');
+const {
+    Registry,
+    LATENCY_BUCKETS,
+    FAST_BUCKETS,
+    monitorEventLoop,
+    mergeRendered,
+    elapsedMs
+} = require('./lib/metrics');
+const { WorkerPool, PrimaryLink } = require('./lib/cluster');
+const { StaticAssets } = require('./lib/static-assets');
+const { createLogger } = require('./lib/log');
+
+// LOG_LEVEL (error / warn / info / debug) and LOG_SAMPLE (per-message lines
+// printed one in N) are read from the environment
+const log = createLogger();
 
 // Initialize Express for serving HTML
 const app = express();
-const port = 3000;
-
-// Serve static files from 'public' folder
-app.use(express.static(path.join(__dirname, 'public')));
-
-// Start HTTP server
-const server = app.listen(port, '0.0.0.0', () => {
-    console.log(`Dashboard running at:`);
-    console.log(`- Local: http://localhost:${port}`);
-    console.log(`- Network: http://YOUR_PC_IP:${port}`);
-    console.log(`Access from any device on your WiFi network!`);
-});
-
-// Initialize WebSocket server
-const wss = new WebSocket.Server({ server });
-
-// Connect to MQTT Broker (replace with your broker IP)
-const mqttClient = mqtt.connect('mqtt://YOUR_PC_IP'); 
-
-// Store connected WebSocket clients
-const clients = new Set();
-
-// Store last known LED state
-let lastLedState = 'unknown';
-
-// WebSocket Connection Handler
-wss.on('connection', (ws) => {
-    console.log('New WebSocket client connected');
-    clients.add(ws);
-
-    // Send initial connection message with current LED state
-    ws.send(JSON.stringify({
-        type: 'connection',
-        status: 'connected'
-    }));
-
-    // Send current LED state immediately after connection
-    if (lastLedState !== 'unknown') {
-        ws.send(JSON.stringify({
-            type: 'led_state',
-            state: lastLedState
-        }));
+const port = parseInt(process.env.PORT, 10) || 3000;
+
+// MQTT broker: an external one (mosquitto), or MQTT_EMBEDDED=1 to host the
+// broker inside this process on MQTT_PORT
+const MQTT_BROKER_URL = process.env.MQTT_BROKER_URL || 'mqtt://YOUR_PC_IP'; // replace with your broker IP
+const MQTT_EMBEDDED = process.env.MQTT_EMBEDDED === '1';
+const MQTT_PORT = parseInt(process.env.MQTT_PORT, 10) || 1883;
+
+// LED commands: wait this long for the device's status, then retry
+const COMMAND_TIMEOUT_MS = parseInt(process.env.COMMAND_TIMEOUT_MS, 10) || 2000;
+// (0 retries: a command fails after its first timeout)
+const COMMAND_RETRIES = process.env.COMMAND_RETRIES !== undefined
+    ? parseInt(process.env.COMMAND_RETRIES, 10) || 0
+    : 2;
+// Minimum gap between commands to one device; rapid toggles in between are
+// collapsed to the latest one (0 disables debouncing)
+const COMMAND_DEBOUNCE_MS = process.env.COMMAND_DEBOUNCE_MS !== undefined
+    ? parseInt(process.env.COMMAND_DEBOUNCE_MS, 10) || 0
+    : 100;
+
+// Last known device states are kept in this file so a restarted server can
+// answer new clients straight away; STATE_FILE= (empty) disables it
+const STATE_FILE = process.env.STATE_FILE !== undefined
+    ? process.env.STATE_FILE
+    : path.join(__dirname, 'data', 'device-state.jsonl');
+
+// Status and command events are appended to segment files in this
+// directory and served by /api/history; HISTORY_DIR= (empty) disables it
+const HISTORY_DIR = process.env.HISTORY_DIR !== undefined
+    ? process.env.HISTORY_DIR
+    : path.join(__dirname, 'data', 'history');
+
+// How long to wait for retained statuses after subscribing before asking
+// the boards for their status (0 asks right away)
+const RETAINED_WAIT_MS = process.env.RETAINED_WAIT_MS !== undefined
+    ? parseInt(process.env.RETAINED_WAIT_MS, 10) || 0
+    : 500;
+
+// Per-client backpressure (bytes queued in a socket)
+const WS_SOFT_LIMIT = parseInt(process.env.WS_SOFT_LIMIT, 10) || 64 * 1024;   // coalesce LED updates above this
+const WS_HARD_LIMIT = parseInt(process.env.WS_HARD_LIMIT, 10) || 1024 * 1024; // disconnect above this
+
+// Ping every client this often and drop the ones that missed the previous
+// ping (half-open connections from sleeping phones); 0 disables it
+const HEARTBEAT_INTERVAL_MS = process.env.HEARTBEAT_INTERVAL_MS !== undefined
+    ? parseInt(process.env.HEARTBEAT_INTERVAL_MS, 10) || 0
+    : 30000;
+
+// The dashboard files are read and compressed (brotli / gzip) once at
+// startup and served from memory; STATIC_PRECOMPRESS=0 serves them from disk
+// on every request instead, so edits show up without a restart
+const STATIC_PRECOMPRESS = process.env.STATIC_PRECOMPRESS !== '0';
+
+// WORKERS=N (N > 1) spreads the WebSocket clients over N worker processes
+// sharing the HTTP port. The primary process keeps the single MQTT
+// connection, the device states, the commands and the files on disk, and
+// passes device updates to the workers over IPC (lib/cluster.js).
+const WORKERS = parseInt(process.env.WORKERS, 10) || 1;
+const CLUSTERED = WORKERS > 1;
+const INGEST = !CLUSTERED || cluster.isPrimary;     // MQTT, state, commands, disk
+const FRONTEND = !CLUSTERED || !cluster.isPrimary;  // HTTP and WebSocket clients
+
+// Events handed out per IPC message when a worker streams the history
+const HISTORY_BATCH = 500;
+
+// Last known LED state of every device. The ingest process owns it; cluster
+// workers keep a replica fed by the updates they receive.
+const devices = new DeviceRegistry();
+
+// Ingest side
+let mqttClient = null;
+let stateStore = null;
+let history = null;
+let commands = null;
+let pool = null;            // cluster primary: the workers
+
+// Frontend side
+let broadcaster = null;
+let heartbeat = null;
+let primary = null;         // cluster worker: link to the primary
+let staticAssets = null;
+const clientsById = new Map();
+
+// Metrics; broadcaster and command counters are read when rendered. In
+// cluster mode every process renders its own and the primary adds them up.
+const metrics = new Registry();
+const metric = {
+    heap: metrics.gauge('process_heap_used_bytes', 'V8 heap in use', () => process.memoryUsage().heapUsed),
+    rss: metrics.gauge('process_resident_memory_bytes', 'Resident set size', () => process.memoryUsage().rss),
+    eventLoopLag: metrics.histogram('eventloop_lag_ms', 'Event-loop lag sampled every 500 ms, ms', LATENCY_BUCKETS)
+};
+monitorEventLoop(metric.eventLoopLag);
+
+// Per-message log lines, sampled
+const logStatus = log.sampler('info');
+const logCommand = log.sampler('info');
+
+// Values the ingest process answers, locally or for the cluster workers
+const queries = {
+    metrics: async () => (CLUSTERED
+        ? mergeRendered([metrics.render(), ...await pool.collect('metrics')])
+        : metrics.render()),
+    clients: () => (CLUSTERED ? pool.collect('clients') : broadcaster.metrics()),
+    state: () => (stateStore ? stateStore.metrics() : { file: null }),
+    commands: () => commands.metrics()
+};
+
+// ---- Ingest: MQTT, device state, commands ---------------------------------
+
+function startIngest() {
+    // Connect to the MQTT broker, or start our own. The embedded broker hands
+    // our publishes and subscriptions over in-process, without a TCP hop.
+    mqttClient = MQTT_EMBEDDED
+        ? startEmbeddedBroker(MQTT_PORT, { log }).client
+        : mqtt.connect(MQTT_BROKER_URL);
+
+    // Last known LED state of every device, restored from the state file
+    // (and the command numbering of each device, see CommandTracker)
+    stateStore = STATE_FILE
+        ? new StateStore(STATE_FILE, () => devices.snapshot(), {
+            log,
+            extra: (deviceId) => commands.persisted(deviceId)
+        })
+        : null;
+    const saved = stateStore ? stateStore.load() : [];
+    if (stateStore) {
+        devices.restore(saved);
+        if (devices.size > 0) {
+            log.info(`Restored the state of ${devices.size} device(s) from ${STATE_FILE}`);
+        }
+    }
+
+    // Status and command events on disk
+    history = HISTORY_DIR ? new EventHistory(HISTORY_DIR, { log }).open() : null;
+
+    // Commands waiting for the device to report the new state
+    commands = new CommandTracker((deviceId, payload) => {
+        mqttPublish(deviceTopic(deviceId, TOPIC_CONTROL), payload);
+    }, {
+        timeout: COMMAND_TIMEOUT_MS,
+        retries: COMMAND_RETRIES,
+        debounce: COMMAND_DEBOUNCE_MS
+    });
+    commands.restore(saved);
+
+    Object.assign(metric, {
+        historyBytes: metrics.gauge('history_bytes', 'Size of the event history on disk', () => (history ? history.metrics().bytes : 0)),
+        mqttIn: metrics.counter('mqtt_messages_received_total', 'MQTT messages received'),
+        mqttRetained: metrics.counter('mqtt_retained_received_total', 'Retained status messages received on subscribe'),
+        mqttOut: metrics.counter('mqtt_messages_published_total', 'MQTT messages published'),
+        devices: metrics.gauge('devices_known', 'Devices with a known LED state', () => devices.size),
+        commandsPending: metrics.gauge('commands_pending', 'LED commands waiting for an acknowledgement', () => commands.pending.size),
+        commandsAcked: metrics.counterFrom('commands_acked_total', 'LED commands acknowledged', () => commands.stats.acked),
+        commandsTimedOut: metrics.counterFrom('commands_timed_out_total', 'LED commands that ran out of retries', () => commands.stats.timedOut),
+        commandRtt: metrics.histogram('command_rtt_ms', 'LED command publish to acknowledging status, ms', LATENCY_BUCKETS)
+    });
+
+    // Tell the client that sent a command whether the device applied it
+    commands.on('ack', (command) => {
+        metric.commandRtt.observe(command.rtt);
+        if (history) {
+            history.append(KIND_ACK, command.deviceId, `${command.state}#${command.seq} rtt=${command.rtt}`);
+        }
+        logCommand(() => `LED command ${command.deviceId}#${command.seq} acknowledged in ${command.rtt} ms`);
+        replyTo(command.origin, {
+            type: 'ack',
+            id: command.origin.id,
+            device: command.deviceId,
+            seq: command.seq,
+            state: command.state,
+            rtt: command.rtt,
+            attempts: command.attempts
+        });
+    });
+
+    commands.on('nack', (command, reason) => {
+        if (history) {
+            history.append(KIND_NACK, command.deviceId, `${command.state}#${command.seq} ${reason}`);
+        }
+        // A newer command to the same device replaced this one; not an error
+        if (reason === 'superseded') {
+            log.debug(`LED command ${command.deviceId}#${command.seq} superseded`);
+        } else {
+            log.warn(`LED command ${command.deviceId}#${command.seq} failed: ${reason}`);
+        }
+        replyTo(command.origin, {
+            type: 'nack',
+            id: command.origin.id,
+            device: command.deviceId,
+            seq: command.seq,
+            state: command.state,
+            reason
+        });
+    });
+
+    // Devices that sent a live (not retained) status since the server started
+    const liveDevices = new Set();
+
+    // MQTT Message Handler (for receiving STM32 updates)
+    mqttClient.on('connect', () => {
+        log.info('Connected to MQTT broker');
+        // LED updates from every device. Boards publish their status retained, so
+        // the broker replays the last one of each device right after subscribing;
+        // the boards are only asked directly if nothing is known after that.
+        mqttClient.subscribe(STATUS_SUBSCRIPTIONS, () => {
+            setTimeout(() => {
+                if (devices.size === 0) {
+                    mqttPublish(TOPIC_STATUS_REQUEST, 'get_status'); // Fill the device map
+                }
+            }, RETAINED_WAIT_MS);
+        });
+    });
+
+    mqttClient.on('message', (topic, message, packet) => {
+        metric.mqttIn.inc();
+        const route = parseTopic(topic);
+        if (route && route.suffix === TOPIC_STATUS) {
+            let ledState;
+            if (packet && packet.retain) {
+                // Last status kept by the broker: warms the cache but acknowledges
+                // nothing, and never overrides what a board has told us since
+                metric.mqttRetained.inc();
+                commands.learn(route.deviceId, message.toString());
+                ledState = parseStatus(message.toString()).state;
+                const known = devices.get(route.deviceId);
+                if (liveDevices.has(route.deviceId) || (known && known.state === ledState)) {
+                    return;
+                }
+            } else {
+                // Resolve the command this status acknowledges (if any) and
+                // update the stored LED state of this device
+                liveDevices.add(route.deviceId);
+                ledState = commands.onStatus(route.deviceId, message.toString());
+                if (history) {
+                    history.append(KIND_STATUS, route.deviceId, message.toString());
+                }
+            }
+            const isNewDevice = !devices.has(route.deviceId);
+            const device = devices.update(route.deviceId, ledState);
+            if (stateStore) {
+                stateStore.record(device);
+            }
+
+            logStatus(() => `LED status update from ${route.deviceId}: ${ledState}`);
+
+            const update = {
+                type: 'led_state',
+                device: route.deviceId,
+                state: ledState,
+                seq: device.seq,
+                updatedAt: device.updatedAt
+            };
+            if (CLUSTERED) {
+                pool.publish(update, isNewDevice);
+            } else {
+                fanOut(update, isNewDevice);
+            }
+        }
+    });
+
+    if (CLUSTERED) {
+        const cursors = new Map();      // "<worker>/<cursor>" -> history iterator
+
+        pool = new WorkerPool(WORKERS, () => devices.snapshot(), Object.assign({
+            // Next batch of a history query streamed by a worker
+            history: async ({ cursor, query }, worker) => {
+                const key = `${worker.id}/${cursor}`;
+                let iterator = cursors.get(key);
+                if (!iterator) {
+                    iterator = history.query({
+                        deviceId: query.deviceId,
+                        from: query.from,
+                        to: query.to === null ? Infinity : query.to,    // Infinity travels as null
+                        limit: query.limit === null ? Infinity : query.limit
+                    });
+                    cursors.set(key, iterator);
+                }
+                const events = [];
+                while (events.length < HISTORY_BATCH) {
+                    const next = await iterator.next();
+                    if (next.done) {
+                        cursors.delete(key);
+                        return { events, done: true };
+                    }
+                    events.push(next.value);
+                }
+                return { events, done: false };
+            }
+        }, queries)).start();
+
+        pool.on('command', (message, worker) => {
+            submitCommand({ worker: worker.id, clientId: message.clientId, id: message.id }, message.device, message.state);
+        });
+        pool.on('status-request', () => mqttPublish(TOPIC_STATUS_REQUEST, 'get_status'));
+        pool.on('history-close', (message, worker) => {
+            const key = `${worker.id}/${message.cursor}`;
+            const iterator = cursors.get(key);
+            if (iterator) {
+                cursors.delete(key);
+                iterator.return();
+            }
+        });
+        pool.on('exit', (worker, code, signal) => {
+            log.warn(`WebSocket worker ${worker.id} exited (${signal || code}), restarting`);
+        });
+        metrics.gauge('cluster_workers', 'WebSocket worker processes', () => pool.ready.size);
+        metrics.counterFrom('cluster_updates_total', 'Device updates passed to the workers', () => pool.stats.updates);
+        metrics.counterFrom('cluster_update_batches_total', 'IPC messages carrying device updates', () => pool.stats.batches);
+
+        cluster.once('listening', () => {
+            log.info(`Dashboard running at http://localhost:${port} with ${WORKERS} WebSocket workers`);
+        });
+    }
+
+    // Save the device states before exiting
+    ['SIGINT', 'SIGTERM'].forEach((signal) => {
+        process.on(signal, () => {
+            if (pool) {
+                pool.stop();
+            }
+            if (stateStore) {
+                stateStore.flushSync();
+            }
+            if (history) {
+                history.close();
+            }
+            process.exit(0);
+        });
+    });
+}
+
+function mqttPublish(topic, payload) {
+    metric.mqttOut.inc();
+    mqttClient.publish(topic, payload);
+}
+
+// Hand an LED command to the tracker; origin identifies the client to answer
+function submitCommand(origin, deviceId, state) {
+    const command = commands.submit(deviceId, state, origin);
+    logCommand(() => `LED command ${deviceId}#${command.seq}: ${state}`);
+    if (history) {
+        history.append(KIND_COMMAND, deviceId, `${state}#${command.seq}`);
+    }
+}
+
+// Message for the client a command came from, in this process or a worker
+function replyTo(origin, message) {
+    if (origin.worker !== undefined) {
+        pool.sendToClient(origin.worker, origin.clientId, message);
     } else {
-        // Request current status from STM32 if we don't know the state
-        mqttClient.publish('led/status_request', 'get_status');
-        console.log('Requested current LED status from STM32');
+        broadcaster.send(origin.client, message);
     }
+}
 
-    // Handle incoming messages from browser
-    ws.on('message', (message) => {
+// ---- Frontend: HTTP and WebSocket clients ---------------------------------
+
+function startFrontend() {
+    // Serve static files from 'public' folder
+    if (STATIC_PRECOMPRESS) {
+        staticAssets = new StaticAssets(path.join(__dirname, 'public')).load();
+        app.use(staticAssets.middleware());
+    } else {
+        app.use(express.static(path.join(__dirname, 'public')));
+    }
+
+    // Counters and histograms in the Prometheus text format
+    app.get('/metrics', async (req, res) => {
+        const text = await query('metrics', res);
+        if (text !== undefined) {
+            res.setHeader('Content-Type', 'text/plain; version=0.0.4');
+            res.end(text);
+        }
+    });
+
+    // Per-client queue depth (bytes buffered and coalesced updates waiting);
+    // one entry per worker in cluster mode
+    app.get('/api/clients', (req, res) => sendQuery('clients', res));
+
+    // Last known state of every device
+    app.get('/api/devices', (req, res) => {
+        res.setHeader('Content-Type', 'application/json');
+        res.end(JSON.stringify(devices.snapshot()));
+    });
+
+    // State file: lines written, pending changes, compactions
+    app.get('/api/state', (req, res) => sendQuery('state', res));
+
+    // Event history as newline-delimited JSON, streamed while it is read:
+    //   /api/history?device=<id>&from=<ms or ISO date>&to=...&limit=1000
+    app.get('/api/history', async (req, res) => {
+        if (!HISTORY_DIR) {
+            res.status(404).end('history disabled\n');
+            return;
+        }
+        const from = parseTime(req.query.from, 0);
+        const to = parseTime(req.query.to, Infinity);
+        if (Number.isNaN(from) || Number.isNaN(to)) {
+            res.status(400).end('invalid from / to\n');
+            return;
+        }
+        res.setHeader('Content-Type', 'application/x-ndjson');
+        let closed = false;
+        res.on('close', () => {
+            closed = true;
+        });
         try {
-            const data = JSON.parse(message);
-            
-            if (data.type === 'control') {
-                // Forward LED command to MQTT
-                mqttClient.publish('led/control', data.state);
-                console.log(`LED command: ${data.state}`);
+            for await (const event of queryHistory({
+                deviceId: req.query.device || null,
+                from,
+                to,
+                limit: parseInt(req.query.limit, 10) || Infinity
+            })) {
+                if (closed) {
+                    break;
+                }
+                if (!res.write(JSON.stringify(event) + '\n')) {
+                    await new Promise((resolve) => {
+                        res.once('drain', resolve);
+                        res.once('close', resolve);
+                    });
+                }
             }
         } catch (error) {
-            console.error('Invalid WebSocket message:', error);
+            log.warn('History query failed:', error.message);
         }
+        res.end();
     });
 
-    // Handle client disconnection
-    ws.on('close', () => {
-        clients.delete(ws);
-        console.log('WebSocket client disconnected');
+    // Pending commands and command round-trip times
+    app.get('/api/commands', (req, res) => sendQuery('commands', res));
+
+    // Start HTTP server
+    const server = app.listen(port, '0.0.0.0', () => {
+        if (!CLUSTERED) {
+            log.info(`Dashboard running at:`);
+            log.info(`- Local: http://localhost:${port}`);
+            log.info(`- Network: http://YOUR_PC_IP:${port}`);
+            log.info(`Access from any device on your WiFi network!`);
+        }
     });
-});
-
-// MQTT Message Handler (for receiving STM32 updates)
-mqttClient.on('connect', () => {
-    console.log('Connected to MQTT broker');
-    mqttClient.subscribe('led/status'); // Subscribe to LED updates
-    mqttClient.subscribe('led/status_request'); // Subscribe to status requests (optional)
-});
-
-mqttClient.on('message', (topic, message) => {
-    if (topic === 'led/status') {
-        // Update stored LED state
-        const ledState = message.toString();
-        lastLedState = ledState;
-        
-        console.log(`LED status update: ${ledState}`); // Debug log
-        
-        // Broadcast LED state to all WebSocket clients
-        clients.forEach((client) => {
-            if (client.readyState === WebSocket.OPEN) {
-                client.send(JSON.stringify({
-                    type: 'led_state',
-                    state: ledState
-                }));
+
+    // Initialize WebSocket server. Clients offering the binary subprotocol get
+    // binary LED frames (public/protocol.js), the others JSON.
+    const wss = new WebSocket.Server({ server, handleProtocols: selectProtocol });
+
+    // Connected WebSocket clients
+    broadcaster = new Broadcaster({
+        softLimit: WS_SOFT_LIMIT,
+        hardLimit: WS_HARD_LIMIT,
+        log
+    });
+
+    // Terminate clients that stop answering pings
+    heartbeat = new Heartbeat(broadcaster.clients, {
+        interval: HEARTBEAT_INTERVAL_MS,
+        onReap: (ws) => {
+            log.info(`Reaping unresponsive WebSocket client #${ws.clientId}`);
+            broadcaster.delete(ws);
+            clientsById.delete(ws.clientId);
+        }
+    }).start();
+
+    Object.assign(metric, {
+        wsConnected: metrics.gauge('ws_connections', 'Open WebSocket connections', () => broadcaster.size),
+        wsConnections: metrics.counter('ws_connections_total', 'WebSocket connections accepted'),
+        wsIn: metrics.counter('ws_messages_received_total', 'Messages received from WebSocket clients'),
+        wsOut: metrics.counterFrom('ws_messages_sent_total', 'Frames sent to WebSocket clients', () => broadcaster.stats.sent),
+        wsCoalesced: metrics.counterFrom('ws_updates_coalesced_total', 'LED updates replaced while a client was congested', () => broadcaster.stats.coalesced),
+        wsDropped: metrics.counterFrom('ws_clients_disconnected_total', 'Slow WebSocket clients disconnected', () => broadcaster.stats.disconnected),
+        wsReaped: metrics.counterFrom('ws_clients_reaped_total', 'WebSocket clients terminated for missing a heartbeat', () => heartbeat.stats.reaped),
+        fanout: metrics.histogram('broadcast_fanout_ms', 'Time to hand one LED update to every watching client, ms', FAST_BUCKETS),
+        staticSent: metrics.counterFrom('static_bytes_sent_total', 'Static file bytes sent (after compression)', () => (staticAssets ? staticAssets.stats.bytesSent : 0)),
+        staticRaw: metrics.counterFrom('static_bytes_uncompressed_total', 'Uncompressed size of the static files sent', () => (staticAssets ? staticAssets.stats.bytesUncompressed : 0)),
+        staticNotModified: metrics.counterFrom('static_not_modified_total', 'Static file requests answered with 304', () => (staticAssets ? staticAssets.stats.notModified : 0))
+    });
+
+    if (CLUSTERED) {
+        primary = new PrimaryLink({
+            metrics: () => metrics.render(),
+            clients: () => Object.assign({ worker: cluster.worker.id }, broadcaster.metrics())
+        });
+        // The device list, then every update applied by the primary
+        primary.on('sync', (message) => devices.restore(message.devices));
+        primary.on('update', (update, isNew) => {
+            devices.restore([{ id: update.device, state: update.state, seq: update.seq, updatedAt: update.updatedAt }]);
+            fanOut(update, isNew);
+        });
+        primary.on('client', (message) => {
+            const ws = clientsById.get(message.clientId);
+            if (ws) {
+                broadcaster.send(ws, message.message);
             }
         });
+        primary.start();
     }
-});
\ No newline at end of file
+
+    // WebSocket Connection Handler
+    wss.on('connection', (ws, req) => {
+        log.info(`New WebSocket client connected (${ws.protocol || 'json'})`);
+        metric.wsConnections.inc();
+        broadcaster.add(ws, { address: req.socket.remoteAddress });
+        clientsById.set(ws.clientId, ws);
+        heartbeat.watch(ws);
+
+        // A reconnecting dashboard names the devices it shows (?watch=a,b),
+        // so the snapshot below is all it needs to resync
+        const watch = new URL(req.url, 'http://localhost').searchParams.get('watch');
+        if (watch) {
+            const ids = watch.split(',').filter(isValidDeviceId);
+            if (ids.length > 0) {
+                broadcaster.unsubscribe(ws, [ALL_DEVICES]);
+                broadcaster.subscribe(ws, ids);
+            }
+        }
+
+        // Send initial connection message
+        broadcaster.send(ws, {
+            type: 'connection',
+            status: 'connected'
+        });
+
+        // Send the state of all known devices in a single frame
+        broadcaster.send(ws, {
+            type: 'snapshot',
+            devices: devices.snapshot()
+        });
+
+        if (devices.size === 0) {
+            // Ask every board for its status if we don't know any yet
+            requestStatus();
+            log.info('Requested current LED status from all devices');
+        }
+
+        // Handle incoming messages from browser
+        ws.on('message', (message, isBinary) => {
+            metric.wsIn.inc();
+            try {
+                const data = isBinary ? protocol.decode(message) : JSON.parse(message);
+
+                if (data.type === 'control') {
+                    // Forward LED command to the device's control topic
+                    if (!isValidDeviceId(data.device)) {
+                        broadcaster.send(ws, { type: 'error', device: data.device, error: 'invalid device' });
+                        return;
+                    }
+                    const state = normalizeCommand(data.state);
+                    if (!state) {
+                        broadcaster.send(ws, { type: 'nack', id: data.id, device: data.device, reason: 'invalid state' });
+                        return;
+                    }
+                    if (CLUSTERED) {
+                        primary.send({ type: 'command', clientId: ws.clientId, id: data.id, device: data.device, state });
+                    } else {
+                        submitCommand({ client: ws, id: data.id }, data.device, state);
+                    }
+                } else if (data.type === 'subscribe' || data.type === 'unsubscribe') {
+                    // Choose which devices this client receives updates for ("*" = all)
+                    const ids = Array.isArray(data.devices)
+                        ? data.devices.filter((id) => id === ALL_DEVICES || isValidDeviceId(id))
+                        : [];
+                    if (data.type === 'unsubscribe') {
+                        broadcaster.unsubscribe(ws, ids);
+                    } else {
+                        subscribeClient(ws, ids);
+                    }
+                }
+            } catch (error) {
+                log.warn('Invalid WebSocket message:', error.message);
+            }
+        });
+
+        // Handle client disconnection
+        ws.on('close', () => {
+            broadcaster.delete(ws);
+            clientsById.delete(ws.clientId);
+            log.info('WebSocket client disconnected');
+        });
+    });
+}
+
+function selectProtocol(offered) {
+    return protocol.PROTOCOLS.find((name) => offered.has(name)) || false;
+}
+
+// A value from the ingest side (see `queries`), asked over IPC in cluster
+// mode. Answers 503 and resolves to undefined if the primary cannot answer.
+async function query(what, res) {
+    try {
+        return CLUSTERED ? await primary.request(what) : await queries[what]();
+    } catch (error) {
+        res.status(503).end(`${error.message}\n`);
+        return undefined;
+    }
+}
+
+async function sendQuery(what, res) {
+    const value = await query(what, res);
+    if (value !== undefined) {
+        res.setHeader('Content-Type', 'application/json');
+        res.end(JSON.stringify(value));
+    }
+}
+
+// History events, read here or pulled from the primary in batches
+let nextCursor = 0;
+async function* queryHistory(options) {
+    if (!CLUSTERED) {
+        yield* history.query(options);
+        return;
+    }
+    const cursor = ++nextCursor;
+    let done = false;
+    try {
+        while (!done) {
+            const batch = await primary.request('history', { cursor, query: options });
+            done = batch.done;
+            yield* batch.events;
+        }
+    } finally {
+        if (!done) {
+            primary.send({ type: 'history-close', cursor });
+        }
+    }
+}
+
+// Milliseconds since the epoch from "1700000000000" or an ISO date
+function parseTime(value, fallback) {
+    if (value === undefined || value === '') {
+        return fallback;
+    }
+    return /^\d+$/.test(value) ? parseInt(value, 10) : Date.parse(value);
+}
+
+function requestStatus() {
+    if (CLUSTERED) {
+        primary.send({ type: 'status-request' });
+    } else {
+        mqttPublish(TOPIC_STATUS_REQUEST, 'get_status');
+    }
+}
+
+// Send LED state to the clients watching this device (serialized once).
+// Slow clients only get the latest state per device once they catch up.
+function fanOut(update, isNewDevice) {
+    const start = process.hrtime.bigint();
+    if (isNewDevice) {
+        // Everybody hears about a new device, so device lists stay complete
+        broadcaster.broadcast(update, update.device);
+    } else {
+        broadcaster.publish(update.device, update);
+    }
+    metric.fanout.observe(elapsedMs(start));
+}
+
+// 'on' / 'off' from the values the firmware accepts (ON, on, 1, ...)
+function normalizeCommand(state) {
+    const value = String(state).toLowerCase();
+    if (value === 'on' || value === '1') return 'on';
+    if (value === 'off' || value === '0') return 'off';
+    return null;
+}
+
+// Add subscriptions and send the current state of the newly watched devices
+function subscribeClient(ws, ids) {
+    const watchedAll = broadcaster.allSubscribers.has(ws);
+    const added = broadcaster.subscribe(ws, ids);
+
+    let states;
+    if (ids.includes(ALL_DEVICES) && !watchedAll) {
+        states = devices.snapshot();
+    } else {
+        states = added.map((id) => devices.get(id)).filter(Boolean);
+    }
+    if (states.length > 0) {
+        broadcaster.send(ws, {
+            type: 'snapshot',
+            partial: true,
+            devices: states
+        });
+    }
+}
+
+if (INGEST) {
+    startIngest();
+}
+if (FRONTEND) {
+    startFrontend();
+}
@@ -0,0 +1,84 @@
+// Command tracker: acknowledgement by sequence number or by state
+
+const test = require('node:test');
+const assert = require('node:assert');
+const { CommandTracker, parseStatus } = require('../lib/commands');
+
+// A tracker that records what it publishes; retries far beyond the tests
+function tracker() {
+    const sent = [];
+    const commands = new CommandTracker((deviceId, payload) => sent.push(payload), {
+        timeout: 60000,
+        debounce: 0
+    });
+    const acked = [];
+    commands.on('ack', (command) => acked.push(command));
+    return { commands, sent, acked };
+}
+
+function finish(commands) {
+    for (const command of Array.from(commands.pending.values())) {
+        commands.finish(command, 'nack', 'test over');
+    }
+}
+
+test('parseStatus splits off the sequence number', () => {
+    assert.deepStrictEqual(parseStatus('LED: ON #7'), { state: 'LED: ON', seq: 7 });
+    assert.deepStrictEqual(parseStatus('LED: OFF'), { state: 'LED: OFF', seq: null });
+});
+
+test('an echoed number acknowledges that command', () => {
+    const { commands, sent, acked } = tracker();
+    commands.learn('dev1', 'LED: OFF #0');
+    const command = commands.submit('dev1', 'on');
+    assert.deepStrictEqual(sent, ['on#1']);
+    commands.onStatus('dev1', 'LED: ON #1');
+    assert.deepStrictEqual(acked, [command]);
+    assert.strictEqual(commands.pending.size, 0);
+});
+
+test('#0 for a command sent without a number is matched by state', () => {
+    const { commands, sent, acked } = tracker();
+    const command = commands.submit('dev1', 'on');
+    assert.deepStrictEqual(sent, ['on']);
+    assert.strictEqual(commands.onStatus('dev1', 'LED: ON #0'), 'LED: ON');
+    assert.deepStrictEqual(acked, [command]);
+    assert.ok(commands.echoesSeq.has('dev1'));
+});
+
+test('an unknown number falls back to the state', () => {
+    const { commands, acked } = tracker();
+    commands.learn('dev1', 'LED: OFF #3');
+    const command = commands.submit('dev1', 'off');
+    commands.onStatus('dev1', 'LED: ON #2');
+    assert.deepStrictEqual(acked, []);
+    commands.onStatus('dev1', 'LED: OFF #2');
+    assert.deepStrictEqual(acked, [command]);
+});
+
+test('a retained status teaches the numbering without acknowledging', () => {
+    const { commands, sent, acked } = tracker();
+    commands.learn('dev1', 'LED: ON #5');
+    commands.submit('dev1', 'on');
+    assert.deepStrictEqual(sent, ['on#6']);
+    assert.deepStrictEqual(acked, []);
+    finish(commands);
+});
+
+test('the numbering survives a restart through persisted() / restore()', () => {
+    const before = tracker();
+    before.commands.learn('dev1', 'LED: OFF #0');
+    before.commands.submit('dev1', 'on');
+    before.commands.submit('dev1', 'off');
+    finish(before.commands);
+    const saved = Object.assign({ id: 'dev1' }, before.commands.persisted('dev1'));
+    assert.deepStrictEqual(saved, { id: 'dev1', echoesSeq: true, commandSeq: 2 });
+    assert.strictEqual(before.commands.persisted('dev2'), null);
+
+    const after = tracker();
+    after.commands.restore([saved, { id: 'dev2', state: 'LED: ON' }]);
+    after.commands.submit('dev1', 'on');
+    after.commands.submit('dev2', 'on');
+    assert.deepStrictEqual(after.sent, ['on#3', 'on']);
+    finish(after.commands);
+});
@@ -0,0 +1,179 @@
+// Embedded broker: retain flag of live and replayed messages
+//
+// The unit tests use a small fake of the aedes API; the end-to-end test
+// starts server.js with MQTT_EMBEDDED=1 and needs the optional aedes (it is
+// skipped without it).
+
+const test = require('node:test');
+const assert = require('node:assert');
+const net = require('net');
+const path = require('path');
+const { spawn } = require('child_process');
+const { EmbeddedClient } = require('../lib/embedded-broker');
+
+// The parts of aedes EmbeddedClient uses. Like aedes, publish() hands the
+// publisher's packet (retain flag included) to every matching subscriber.
+function fakeBroker() {
+    const subscriptions = [];
+    const retained = new Map();
+    return {
+        subscribe(topic, deliver, done) {
+            subscriptions.push({ topic, deliver });
+            setImmediate(done);
+        },
+        unsubscribe(topic, deliver, done) {
+            const i = subscriptions.findIndex((s) => s.topic === topic && s.deliver === deliver);
+            if (i >= 0) {
+                subscriptions.splice(i, 1);
+            }
+            setImmediate(done);
+        },
+        publish(packet, done) {
+            if (packet.retain) {
+                retained.set(packet.topic, packet);
+            }
+            subscriptions.filter((s) => s.topic === packet.topic).forEach((s) => s.deliver(packet, () => {}));
+            setImmediate(done);
+        },
+        persistence: {
+            createRetainedStreamCombi(topics) {
+                const { Readable } = require('stream');
+                return Readable.from(topics.filter((t) => retained.has(t)).map((t) => retained.get(t)));
+            }
+        }
+    };
+}
+
+function nextMessage(client) {
+    return new Promise((resolve) => {
+        client.once('message', (topic, payload, packet) => resolve({ topic, payload: payload.toString(), packet }));
+    });
+}
+
+test('live messages arrive with retain cleared', async () => {
+    const broker = fakeBroker();
+    const client = new EmbeddedClient(broker);
+    const device = new EmbeddedClient(broker);
+    await new Promise((resolve) => client.subscribe('dev1/led/status', resolve));
+
+    const received = nextMessage(client);
+    device.publish('dev1/led/status', 'LED: ON #1', { retain: true });
+    const { payload, packet } = await received;
+    assert.strictEqual(payload, 'LED: ON #1');
+    assert.strictEqual(packet.retain, false);
+});
+
+test('retained messages replayed on subscribe keep retain set', async () => {
+    const broker = fakeBroker();
+    const device = new EmbeddedClient(broker);
+    await new Promise((resolve) => device.publish('dev1/led/status', 'LED: OFF #4', { retain: true }, resolve));
+
+    const client = new EmbeddedClient(broker);
+    const received = nextMessage(client);
+    client.subscribe('dev1/led/status');
+    const { payload, packet } = await received;
+    assert.strictEqual(payload, 'LED: OFF #4');
+    assert.strictEqual(packet.retain, true);
+});
+
+// ---- server.js end to end -------------------------------------------------
+
+function installed(name) {
+    try {
+        require.resolve(name);
+        return true;
+    } catch (error) {
+        return false;
+    }
+}
+
+function freePort() {
+    return new Promise((resolve, reject) => {
+        const probe = net.createServer();
+        probe.once('error', reject);
+        probe.listen(0, '127.0.0.1', () => {
+            const { port } = probe.address();
+            probe.close(() => resolve(port));
+        });
+    });
+}
+
+async function waitFor(check, timeout) {
+    const deadline = Date.now() + timeout;
+    while (Date.now() < deadline) {
+        try {
+            if (await check()) {
+                return;
+            }
+        } catch (error) {
+            // not up yet
+        }
+        await new Promise((resolve) => setTimeout(resolve, 50));
+    }
+    throw new Error('timed out');
+}
+
+test('a command is acked by a live status the board publishes retained', {
+    skip: !['aedes', 'mqtt', 'ws', 'express'].every(installed) && 'needs aedes, mqtt, ws and express'
+}, async () => {
+    const mqtt = require('mqtt');
+    const WebSocket = require('ws');
+    const [port, mqttPort] = [await freePort(), await freePort()];
+    const server = spawn(process.execPath, [path.join(__dirname, '..', 'server.js')], {
+        env: Object.assign({}, process.env, {
+            PORT: String(port),
+            MQTT_EMBEDDED: '1',
+            MQTT_PORT: String(mqttPort),
+            STATE_FILE: '',
+            HISTORY_DIR: '',
+            COMMAND_DEBOUNCE_MS: '0',
+            LOG_LEVEL: 'error'
+        }),
+        stdio: 'ignore'
+    });
+    let board = null;
+    let ws = null;
+    try {
+        await waitFor(async () => (await fetch(`http://127.0.0.1:${port}/metrics`)).ok, 10000);
+
+        // A board with the default firmware settings: status published
+        // retained, commands answered with "LED: ON #<seq>"
+        board = mqtt.connect(`mqtt://127.0.0.1:${mqttPort}`);
+        await new Promise((resolve) => board.once('connect', resolve));
+        board.on('message', (topic, payload) => {
+            const [state, seq] = payload.toString().split('#');
+            board.publish('dev1/led/status', `LED: ${state.toUpperCase()} #${seq || 0}`, { retain: true });
+        });
+        await new Promise((resolve) => board.subscribe('dev1/led/control', resolve));
+        board.publish('dev1/led/status', 'LED: OFF #0', { retain: true });
+        await waitFor(async () => (await (await fetch(`http://127.0.0.1:${port}/api/devices`)).json()).length === 1, 5000);
+
+        ws = new WebSocket(`ws://127.0.0.1:${port}`);
+        await new Promise((resolve) => ws.once('open', resolve));
+        const reply = new Promise((resolve) => {
+            ws.on('message', (data) => {
+                const message = JSON.parse(data);
+                if (message.type === 'ack' || message.type === 'nack') {
+                    resolve(message);
+                }
+            });
+        });
+        ws.send(JSON.stringify({ type: 'control', id: 1, device: 'dev1', state: 'on' }));
+        const message = await reply;
+        assert.strictEqual(message.type, 'ack');
+        assert.strictEqual(message.attempts, 1);
+
+        const stats = await (await fetch(`http://127.0.0.1:${port}/api/commands`)).json();
+        assert.strictEqual(stats.acked, 1);
+        assert.strictEqual(stats.retried, 0);
+        assert.strictEqual(stats.pending, 0);
+    } finally {
+        if (ws) {
+            ws.terminate();
+        }
+        if (board) {
+            board.end(true);
+        }
+        server.kill();
+    }
+});
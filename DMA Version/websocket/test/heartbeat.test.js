@@ -0,0 +1,49 @@
+// WebSocket heartbeat: pings, reaping and the interval option
+
+const test = require('node:test');
+const assert = require('node:assert');
+const { EventEmitter } = require('events');
+const { Heartbeat } = require('../lib/heartbeat');
+
+// Enough of a ws client for the heartbeat
+function fakeClient() {
+    const client = new EventEmitter();
+    client.pings = 0;
+    client.terminated = false;
+    client.ping = () => client.pings++;
+    client.terminate = () => {
+        client.terminated = true;
+    };
+    return client;
+}
+
+test('an interval of 0 disables the heartbeat', () => {
+    const heartbeat = new Heartbeat(new Set(), { interval: 0 }).start();
+    assert.strictEqual(heartbeat.interval, 0);
+    assert.strictEqual(heartbeat.timer, null);
+});
+
+test('the interval defaults to 30 s', () => {
+    const heartbeat = new Heartbeat(new Set()).start();
+    assert.strictEqual(heartbeat.interval, 30000);
+    assert.notStrictEqual(heartbeat.timer, null);
+    heartbeat.stop();
+});
+
+test('a client that misses a pong is reaped on the next check', () => {
+    const alive = fakeClient();
+    const dead = fakeClient();
+    const reaped = [];
+    const heartbeat = new Heartbeat(new Set([alive, dead]), { onReap: (client) => reaped.push(client) });
+    heartbeat.watch(alive);
+    heartbeat.watch(dead);
+
+    heartbeat.check();
+    alive.emit('pong');
+    heartbeat.check();
+    assert.deepStrictEqual(reaped, [dead]);
+    assert.ok(dead.terminated);
+    assert.ok(!alive.terminated);
+    assert.strictEqual(alive.pings, 2);
+    assert.deepStrictEqual(heartbeat.stats, { pings: 3, reaped: 1 });
+});
@@ -0,0 +1,98 @@
+// Event history: range queries over written and buffered records
+
+const test = require('node:test');
+const assert = require('node:assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { EventHistory, KIND_STATUS } = require('../lib/history');
+
+async function collect(history, query) {
+    const events = [];
+    for await (const event of history.query(query)) {
+        events.push(event);
+    }
+    return events;
+}
+
+function open(t, options) {
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'history-test-'));
+    const history = new EventHistory(dir, options).open();
+    t.after(() => {
+        history.close();
+        fs.rmSync(dir, { recursive: true, force: true });
+    });
+    return history;
+}
+
+test('a query returns the written records in the range', async (t) => {
+    const history = open(t, { indexEvery: 2 });
+    for (let i = 0; i < 10; i++) {
+        history.append(KIND_STATUS, 'dev1', `LED: ${i % 2 ? 'ON' : 'OFF'} #${i}`, 1000 + i);
+    }
+    history.flush();
+    const events = await collect(history, { from: 1004, to: 1006 });
+    assert.deepStrictEqual(events.map((e) => e.data), ['LED: OFF #4', 'LED: ON #5', 'LED: OFF #6']);
+    assert.strictEqual(events[0].event, 'status');
+});
+
+test('records indexed but not yet written are left out, not an error', async (t) => {
+    const history = open(t, { indexEvery: 2, flushInterval: 60000 });
+    for (let i = 0; i < 4; i++) {
+        history.append(KIND_STATUS, 'dev1', `LED: ON #${i}`, 1000 + i);
+    }
+    history.flush();
+    // Indexed at once, still in the write buffer
+    for (let i = 4; i < 10; i++) {
+        history.append(KIND_STATUS, 'dev1', `LED: ON #${i}`, 1000 + i);
+    }
+    assert.deepStrictEqual(await collect(history, { from: 1008 }), []);
+    assert.strictEqual((await collect(history, { from: 1002 })).length, 2);
+
+    history.flush();
+    assert.strictEqual((await collect(history, { from: 1008 })).length, 2);
+});
+
+test('a failed write is rolled back so later records keep their offsets', async (t) => {
+    const history = open(t, { indexEvery: 1, flushInterval: 60000 });
+    history.log = { warn: () => {} };
+    history.append(KIND_STATUS, 'dev1', 'LED: ON #1', 1000);
+    history.flush();
+
+    const writeSync = fs.writeSync;
+    fs.writeSync = () => {
+        throw new Error('disk full');
+    };
+    try {
+        history.append(KIND_STATUS, 'dev1', 'LED: OFF #2', 1001);
+        history.append(KIND_STATUS, 'dev1', 'LED: ON #3', 1002);
+        history.flush();
+    } finally {
+        fs.writeSync = writeSync;
+    }
+    assert.strictEqual(history.stats.dropped, 2);
+
+    history.append(KIND_STATUS, 'dev1', 'LED: OFF #4', 1003);
+    history.flush();
+    const segment = history.current;
+    assert.strictEqual(segment.size, segment.written);
+    assert.strictEqual(segment.records, 2);
+    assert.deepStrictEqual((await collect(history, { from: 1003 })).map((e) => e.data), ['LED: OFF #4']);
+    assert.deepStrictEqual((await collect(history, {})).map((e) => e.data), ['LED: ON #1', 'LED: OFF #4']);
+});
+
+test('a record length below the header size ends the segment instead of hanging', async (t) => {
+    const history = open(t, { indexEvery: 1 });
+    const warnings = [];
+    history.log = { warn: (message) => warnings.push(message) };
+    history.append(KIND_STATUS, 'dev1', 'LED: ON #1', 1000);
+    history.append(KIND_STATUS, 'dev1', 'LED: OFF #2', 1001);
+    history.flush();
+    // Zero the length field of the second record
+    const fd = fs.openSync(history.current.file, 'r+');
+    fs.writeSync(fd, Buffer.alloc(2), 0, 2, history.current.index[1][1]);
+    fs.closeSync(fd);
+
+    assert.deepStrictEqual((await collect(history, {})).map((e) => e.data), ['LED: ON #1']);
+    assert.strictEqual(warnings.length, 1);
+});
@@ -0,0 +1,41 @@
+// Binary WebSocket protocol: encode / decode round trips and malformed frames
+
+const test = require('node:test');
+const assert = require('node:assert');
+const protocol = require('../public/protocol');
+
+test('a state update survives a round trip', () => {
+    const message = { type: 'led_state', device: 'dev1', state: 'LED: ON', seq: 7, updatedAt: 1700000000000 };
+    assert.deepStrictEqual(protocol.decode(protocol.encodeMessage(message)), message);
+});
+
+test('a snapshot survives a round trip', () => {
+    const message = {
+        type: 'snapshot',
+        partial: true,
+        devices: [
+            { id: 'dev1', state: 'LED: ON', seq: 1, updatedAt: 1 },
+            { id: 'dev2', state: 'LED: OFF', seq: 2, updatedAt: 2 }
+        ]
+    };
+    assert.deepStrictEqual(protocol.decode(protocol.encodeMessage(message)), message);
+});
+
+test('a control frame decodes to the command', () => {
+    const frame = protocol.encodeMessage({ type: 'control', device: 'dev1', state: 'off', id: 3 });
+    assert.deepStrictEqual(protocol.decode(frame), { type: 'control', device: 'dev1', state: 'off', id: 3 });
+});
+
+test('a control frame with an undefined state byte is rejected', () => {
+    for (const state of [protocol.STATE_UNKNOWN, 3, 255]) {
+        const frame = protocol.encode(protocol.TYPE_CONTROL, [{ id: 'dev1', state, seq: 1, time: 0 }]);
+        assert.throws(() => protocol.decode(frame), /valid state/);
+    }
+});
+
+test('truncated and unknown frames are rejected', () => {
+    const frame = protocol.encodeMessage({ type: 'led_state', device: 'dev1', state: 'LED: ON', seq: 1, updatedAt: 0 });
+    assert.throws(() => protocol.decode(frame.subarray(0, frame.length - 1)), /truncated/);
+    assert.throws(() => protocol.decode(protocol.encode(9, [])), /unknown frame type/);
+    assert.throws(() => protocol.decode(protocol.encode(protocol.TYPE_CONTROL, [])), /valid state/);
+});
@@ -33,6 +33,14 @@ typedef enum {
     ESP8266_TIMEOUT = 2
 } ESP8266_Status_t;
 
+typedef struct {
+    uint32_t overrun;               /* ORE: byte lost before it was read */
+    uint32_t framing;               /* FE: missing stop bit (baud mismatch, noisy wiring) */
+    uint32_t noise;                 /* NE: noise detected while sampling a bit */
+    uint32_t parity;                /* PE: parity mismatch (only with parity enabled) */
+    uint32_t rx_restarts;           /* Receive interrupt chain re-armed after an error */
+} ESP8266_UART_ErrorStats_t;
+
 /* Exported constants --------------------------------------------------------*/
 #define ESP8266_BUFFER_SIZE         512
 
@@ -52,14 +60,18 @@ extern UART_HandleTypeDef huart2;
 
 /* Exported function prototypes ---------------------------------------------*/
 ESP8266_Status_t ESP8266_Init(void);
+ESP8266_Status_t ESP8266_ConfigureUART(uint32_t baudrate, bool flow_control);
 ESP8266_Status_t ESP8266_ConnectWiFi(const char* ssid, const char* password);
 ESP8266_Status_t ESP8266_ConnectMQTT(const char* broker_ip, uint16_t port, const char* client_id);
 ESP8266_Status_t ESP8266_SubscribeMQTT(const char* topic);
 ESP8266_Status_t ESP8266_PublishMQTT(const char* topic, const char* message);
+ESP8266_Status_t ESP8266_PublishMQTTEx(const char* topic, const char* message, uint8_t qos, bool retain);
 ESP8266_Status_t ESP8266_SendCommand(const char* command, const char* expected_response, uint32_t timeout);
 ESP8266_Status_t ESP8266_ProcessReceivedData(void);
 void ESP8266_ClearBuffer(void);
 void ESP8266_UART_RxCallback(uint8_t data);
+void ESP8266_UART_ErrorCallback(UART_HandleTypeDef* huart);
+void ESP8266_GetUARTErrorStats(ESP8266_UART_ErrorStats_t* stats);
 
 /* Callback function prototypes */
 void ESP8266_OnMQTTMessageReceived(const char* topic, const char* message);
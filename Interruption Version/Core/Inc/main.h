@@ -62,6 +62,24 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
 /* Private defines -----------------------------------------------------------*/
 
 /* USER CODE BEGIN Private defines */
+/* ESP8266 link on USART2. The module boots at 115200 baud without flow control;
+   ESP8266_ConfigureUART() switches both ends to these settings after reset.
+   Flow control wiring: PA0 (USART2_CTS) <- ESP8266 GPIO15 (RTS)
+                        PA1 (USART2_RTS) -> ESP8266 GPIO13 (CTS)
+   PA0 is shared with the Discovery user button - do not press it. */
+#ifndef ESP8266_UART_BAUDRATE
+#define ESP8266_UART_BAUDRATE       115200
+#endif
+#ifndef ESP8266_UART_FLOW_CONTROL
+#define ESP8266_UART_FLOW_CONTROL   0
+#endif
+
+/* Publish LED status with the MQTT retain flag, so the broker hands the last
+   status to every new subscriber (e.g. a restarted dashboard server) without
+   a led/status_request round trip to the board. 0 = plain publish. */
+#ifndef MQTT_STATUS_RETAIN
+#define MQTT_STATUS_RETAIN          1
+#endif
 
 /* USER CODE END Private defines */
 
@@ -22,6 +22,10 @@ static char esp8266_buffer[ESP8266_BUFFER_SIZE];
 static uint16_t esp8266_buffer_index = 0;
 static bool mqtt_subscribed = false;
 
+/* UART error recovery */
+static volatile ESP8266_UART_ErrorStats_t uart_error_stats;
+static bool rx_resync = false;      // Dropping bytes until the next line boundary
+
 /* External variables --------------------------------------------------------*/
 // All external variables are declared in main.h
 
@@ -30,6 +34,7 @@ static void ESP8266_Delay(uint32_t ms);
 static ESP8266_Status_t ESP8266_WaitForResponse(const char* expected, uint32_t timeout);
 static void ESP8266_UART_Transmit(const char* data);
 static void ESP8266_ProcessBuffer(void);
+static void ESP8266_DiscardPartialLine(void);
 
 /* Exported functions --------------------------------------------------------*/
 
@@ -72,6 +77,39 @@ ESP8266_Status_t ESP8266_Init(void)
 }
 
 
+/**
+  * @brief  Set the module's UART baud rate and RTS/CTS flow control
+  * @note   Uses AT+UART_CUR (not saved to flash), call again after every reset.
+  *         huart2 follows the new baud rate; its HwFlowCtl must already
+  *         match flow_control.
+  * @param  baudrate: New baud rate
+  * @param  flow_control: true to enable RTS/CTS on the module
+  * @retval ESP8266_Status_t
+  */
+ESP8266_Status_t ESP8266_ConfigureUART(uint32_t baudrate, bool flow_control)
+{
+    char command[64];
+    snprintf(command, sizeof(command), "AT+UART_CUR=%lu,8,1,0,%d\r\n", (unsigned long)baudrate, flow_control ? 3 : 0);
+    
+    if (ESP8266_SendCommand(command, "OK", 1000) != ESP8266_OK) {
+        return ESP8266_ERROR;
+    }
+    
+    if (baudrate == huart2.Init.BaudRate) {
+        return ESP8266_OK;
+    }
+    
+    // The module answered "OK" at the old rate and has switched - follow it
+    HAL_UART_AbortReceive_IT(&huart2);
+    huart2.Init.BaudRate = baudrate;
+    if (HAL_UART_Init(&huart2) != HAL_OK) {
+        return ESP8266_ERROR;
+    }
+    
+    // Confirm the link at the new rate (SendCommand re-arms reception)
+    return ESP8266_SendCommand("AT\r\n", "OK", 1000);
+}
+
 /**
   * @brief  Connect to WiFi network
   * @param  ssid: WiFi network name
@@ -127,15 +165,28 @@ ESP8266_Status_t ESP8266_SubscribeMQTT(const char* topic)
 }
 
 /**
-  * @brief  Publish message to MQTT topic
+  * @brief  Publish message to MQTT topic (QoS 1, not retained)
   * @param  topic: MQTT topic
   * @param  message: Message to publish
   * @retval ESP8266_Status_t
   */
 ESP8266_Status_t ESP8266_PublishMQTT(const char* topic, const char* message)
+{
+    return ESP8266_PublishMQTTEx(topic, message, 1, false);
+}
+
+/**
+  * @brief  Publish message to MQTT topic with explicit QoS and retain flag
+  * @param  topic: MQTT topic
+  * @param  message: Message to publish
+  * @param  qos: 0, 1 or 2
+  * @param  retain: true to have the broker keep it for later subscribers
+  * @retval ESP8266_Status_t
+  */
+ESP8266_Status_t ESP8266_PublishMQTTEx(const char* topic, const char* message, uint8_t qos, bool retain)
 {
     char command[256];
-    snprintf(command, sizeof(command), "AT+MQTTPUB=0,\"%s\",\"%s\",1,0\r\n", topic, message);
+    snprintf(command, sizeof(command), "AT+MQTTPUB=0,\"%s\",\"%s\",%d,%d\r\n", topic, message, qos, retain ? 1 : 0);
     return ESP8266_SendCommand(command, "OK", 1000);
 }
 
@@ -149,6 +200,7 @@ ESP8266_Status_t ESP8266_PublishMQTT(const char* topic, const char* message)
 ESP8266_Status_t ESP8266_SendCommand(const char* command, const char* expected_response, uint32_t timeout)
 {
     ESP8266_ClearBuffer();
+    rx_resync = false;
     
     // Ensure UART RX interrupt is active
     if (huart2.RxState == HAL_UART_STATE_READY) {
@@ -303,6 +355,14 @@ static void ESP8266_ProcessBuffer(void)
   */
 void ESP8266_UART_RxCallback(uint8_t data)
 {
+    // After a receive error, skip the rest of the damaged line
+    if (rx_resync) {
+        if (data == '\n') {
+            rx_resync = false;
+        }
+        return;
+    }
+    
     if (esp8266_buffer_index < ESP8266_BUFFER_SIZE - 1) {
         esp8266_buffer[esp8266_buffer_index++] = data;
         esp8266_buffer[esp8266_buffer_index] = '\0';
@@ -326,6 +386,66 @@ void ESP8266_UART_RxCallback(uint8_t data)
     }
 }
 
+/**
+  * @brief  UART error handler (to be called from HAL_UART_ErrorCallback)
+  * @note   An overrun ends HAL's receive-IT chain, so it is re-armed here;
+  *         framing and noise errors leave it running.
+  * @param  huart: UART handle that reported the error
+  * @retval None
+  */
+void ESP8266_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+    if (huart->Instance != huart2.Instance) {
+        return;
+    }
+    
+    uint32_t error = huart->ErrorCode;
+    if (error & HAL_UART_ERROR_ORE) uart_error_stats.overrun++;
+    if (error & HAL_UART_ERROR_FE)  uart_error_stats.framing++;
+    if (error & HAL_UART_ERROR_NE)  uart_error_stats.noise++;
+    if (error & HAL_UART_ERROR_PE)  uart_error_stats.parity++;
+    
+    // Reading SR then DR clears PE/FE/NE/ORE
+    __HAL_UART_CLEAR_PEFLAG(huart);
+    
+    // The line in progress lost or garbled a byte - drop it and resync on the
+    // next one, complete lines (e.g. an "OK" being waited for) are kept
+    ESP8266_DiscardPartialLine();
+    rx_resync = true;
+    
+    if (huart->RxState == HAL_UART_STATE_READY) {
+        uart_error_stats.rx_restarts++;
+        HAL_UART_Receive_IT(&huart2, uart_rx_buffer, 1);
+    }
+}
+
+/**
+  * @brief  Get UART error counters
+  * @param  stats: Destination for a snapshot of the counters
+  * @retval None
+  */
+void ESP8266_GetUARTErrorStats(ESP8266_UART_ErrorStats_t* stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    
+    __disable_irq();
+    *stats = uart_error_stats;
+    __enable_irq();
+}
+
+/**
+  * @brief  Remove an incomplete trailing line from the buffer
+  * @retval None
+  */
+static void ESP8266_DiscardPartialLine(void)
+{
+    while (esp8266_buffer_index > 0 && esp8266_buffer[esp8266_buffer_index - 1] != '\n') {
+        esp8266_buffer[--esp8266_buffer_index] = '\0';
+    }
+}
+
 /**
   * @brief  Weak callback function for MQTT message reception
   * @param  topic: MQTT topic
@@ -59,6 +59,7 @@ static void MX_USART2_UART_Init(void);
 void LED_Control(bool state);
 void ESP8266_OnMQTTMessageReceived(const char* topic, const char* message);
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -100,6 +101,10 @@ int main(void)
   
   // Initialize ESP8266 WiFi module
   if (ESP8266_Init() == ESP8266_OK) {
+#if ESP8266_UART_FLOW_CONTROL || (ESP8266_UART_BAUDRATE != 115200)
+    // Move the link to the configured speed / flow control (stays at 115200 on failure)
+    ESP8266_ConfigureUART(ESP8266_UART_BAUDRATE, ESP8266_UART_FLOW_CONTROL);
+#endif
     // Connect to WiFi
     if (ESP8266_ConnectWiFi(WIFI_SSID, WIFI_PASSWORD) == ESP8266_OK) {
       // Connect to MQTT broker
@@ -109,7 +114,7 @@ int main(void)
         
         // Publish initial status
         snprintf(status_message, sizeof(status_message), "STM32 Connected - LED: %s", led_state ? "ON" : "OFF");
-        ESP8266_PublishMQTT(MQTT_TOPIC_LED_STATUS, status_message);
+        ESP8266_PublishMQTTEx(MQTT_TOPIC_LED_STATUS, status_message, 1, MQTT_STATUS_RETAIN);
       }
     }
   }
@@ -127,7 +132,7 @@ int main(void)
     if (status_update_pending) {
       status_update_pending = false;
       snprintf(status_message, sizeof(status_message), "LED: %s", led_state ? "ON" : "OFF");
-      ESP8266_PublishMQTT(MQTT_TOPIC_LED_STATUS, status_message);
+      ESP8266_PublishMQTTEx(MQTT_TOPIC_LED_STATUS, status_message, 1, MQTT_STATUS_RETAIN);
     }
     /* USER CODE END 3 */
   }
@@ -202,6 +207,14 @@ static void MX_USART2_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART2_Init 2 */
+#if ESP8266_UART_FLOW_CONTROL
+  // RTS/CTS on PA1/PA0 (pins muxed in HAL_UART_MspInit)
+  huart2.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+  if (HAL_UART_Init(&huart2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
 
   /* USER CODE END USART2_Init 2 */
 
@@ -306,6 +319,19 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
     }
 }
 
+/**
+  * @brief  UART error callback
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        // Clear ORE/FE/NE and re-arm reception (an overrun ends the IT chain)
+        ESP8266_UART_ErrorCallback(huart);
+    }
+}
+
 /* USER CODE END 4 */
 
 /**
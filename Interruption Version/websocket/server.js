@@ -2,6 +2,7 @@ const express = require('express');
 const WebSocket = require('ws');
 const mqtt = require('mqtt');
 const path = require('path');
+const fs = require('fs');
 
 // Initialize Express for serving HTML
 const app = express();
@@ -24,6 +25,62 @@ const mqttClient = mqtt.connect('mqtt://YOUR_PC_IP');
 // Store connected WebSocket clients
 const clients = new Set();
 
+// Last LED status, kept in a file so a restarted server can answer new
+// clients straight away instead of waiting for the board
+const STATE_FILE = path.join(__dirname, 'led-state.json');
+const STATE_SAVE_DELAY_MS = 1000; // batch rapid changes into one write
+const savedLedState = loadLedState();
+let lastLedState = savedLedState.state;
+let lastLedStateAt = savedLedState.updatedAt; // when the board reported it
+let saveTimer = null;
+let saving = false; // an asynchronous save has not been renamed into place yet
+
+function loadLedState() {
+    try {
+        const saved = JSON.parse(fs.readFileSync(STATE_FILE, 'utf8'));
+        return { state: saved.state || null, updatedAt: saved.updatedAt || null };
+    } catch (error) {
+        return { state: null, updatedAt: null };
+    }
+}
+
+function stateFileContents() {
+    return JSON.stringify({ state: lastLedState, updatedAt: lastLedStateAt });
+}
+
+// Write through a temporary file so a crash never leaves a torn file
+function saveLedState() {
+    if (saveTimer) {
+        return;
+    }
+    saveTimer = setTimeout(() => {
+        saveTimer = null;
+        saving = true;
+        const temp = `${STATE_FILE}.tmp`;
+        fs.writeFile(temp, stateFileContents(), (error) => {
+            if (error) {
+                saving = false;
+                console.error('Cannot save LED state:', error.message);
+            } else {
+                fs.rename(temp, STATE_FILE, () => {
+                    saving = false;
+                });
+            }
+        });
+    }, STATE_SAVE_DELAY_MS);
+}
+
+// Same as saveLedState(), at once and synchronously (before exiting)
+function saveLedStateSync() {
+    const temp = `${STATE_FILE}.tmp`;
+    try {
+        fs.writeFileSync(temp, stateFileContents());
+        fs.renameSync(temp, STATE_FILE);
+    } catch (error) {
+        console.error('Cannot save LED state:', error.message);
+    }
+}
+
 // WebSocket Connection Handler
 wss.on('connection', (ws) => {
     console.log('New WebSocket client connected');
@@ -35,6 +92,14 @@ wss.on('connection', (ws) => {
         status: 'connected'
     }));
 
+    // Send the last known LED state, if any
+    if (lastLedState !== null) {
+        ws.send(JSON.stringify({
+            type: 'led_state',
+            state: lastLedState
+        }));
+    }
+
     // Handle incoming messages from browser
     ws.on('message', (message) => {
         try {
@@ -65,15 +130,31 @@ mqttClient.on('connect', () => {
 
 mqttClient.on('message', (topic, message) => {
     if (topic === 'led/status') {
+        lastLedState = message.toString();
+        lastLedStateAt = Date.now();
+        saveLedState();
+
         // Broadcast LED state to all WebSocket clients
-        const ledState = message.toString();
+        // Serialize once and share the buffer, instead of once per client
+        const frame = Buffer.from(JSON.stringify({
+            type: 'led_state',
+            state: message.toString()
+        }));
         clients.forEach((client) => {
             if (client.readyState === WebSocket.OPEN) {
-                client.send(JSON.stringify({
-                    type: 'led_state',
-                    state: ledState
-                }));
+                client.send(frame, { binary: false });
             }
         });
     }
-});
\ No newline at end of file
+});
+
+// Save a pending LED state change before exiting
+['SIGINT', 'SIGTERM'].forEach((signal) => {
+    process.on(signal, () => {
+        if (saveTimer || saving) {
+            clearTimeout(saveTimer);
+            saveLedStateSync();
+        }
+        process.exit(0);
+    });
+});
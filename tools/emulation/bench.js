@@ -0,0 +1,320 @@
+#!/usr/bin/env node
+// Emulated-target benchmark for the DMA and Interruption firmware builds
+//
+// Boots each build's Debug/mqtt_dashboard.elf in Renode (dashboard.resc),
+// wires USART2 to the ESP8266 simulator and replays the same control traffic
+// against both. Instrumentation is done with Renode CPU hooks whose addresses
+// come from the build's own mqtt_dashboard.list / .map, so the firmware is run
+// unmodified. All times are firmware ticks (uwTick, 1 ms of virtual time).
+//
+// Usage:
+//   node bench.js [--renode renode] [--build dma|it|both] [--commands 40]
+//                 [--gap 250] [--port 3456] [--seed 1] [--json results.json]
+
+const fs = require('fs');
+const os = require('os');
+const net = require('net');
+const path = require('path');
+const { spawn } = require('child_process');
+const { Esp8266Simulator } = require('../esp8266-sim/esp8266-sim');
+
+const REPO = path.resolve(__dirname, '..', '..');
+const BUILDS = {
+    dma: { name: 'DMA Version', dir: path.join(REPO, 'DMA Version', 'Debug') },
+    it: { name: 'Interruption Version', dir: path.join(REPO, 'Interruption Version', 'Debug') }
+};
+const ISRS = ['SysTick_Handler', 'USART2_IRQHandler', 'DMA1_Stream5_IRQHandler', 'DMA1_Stream6_IRQHandler'];
+const STARTUP_TIMEOUT_MS = 180000;
+const COMMAND_TIMEOUT_MS = 30000;
+
+function parseCommandLine(argv) {
+    const opts = { renode: 'renode', build: 'both', commands: 40, gap: 250, port: 3456, seed: 1, json: null };
+    for (let i = 0; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--renode': opts.renode = value; i++; break;
+            case '--build': opts.build = value; i++; break;
+            case '--commands': opts.commands = parseInt(value, 10); i++; break;
+            case '--gap': opts.gap = parseInt(value, 10); i++; break;
+            case '--port': opts.port = parseInt(value, 10); i++; break;
+            case '--seed': opts.seed = parseInt(value, 10); i++; break;
+            case '--json': opts.json = value; i++; break;
+            default: throw new Error(`Unknown option: ${argv[i]}`);
+        }
+    }
+    return opts;
+}
+
+// ---- Build artefacts ----------------------------------------------------------
+
+// Function entry addresses and return instructions from the objdump listing
+function parseListing(file) {
+    const symbols = new Map();
+    const returns = new Map();
+    let current = null;
+
+    fs.readFileSync(file, 'utf8').split(/\r?\n/).forEach((line) => {
+        let m = /^([0-9a-f]{8}) <([^>]+)>:$/.exec(line);
+        if (m) {
+            current = m[2];
+            symbols.set(current, parseInt(m[1], 16));
+            returns.set(current, []);
+            return;
+        }
+        m = /^\s*([0-9a-f]+):\t[0-9a-f ]+\t(?:pop(?:\.w)?\t\{[^}]*\bpc\}|bx\tlr)/.exec(line);
+        if (m && current) {
+            returns.get(current).push(parseInt(m[1], 16));
+        }
+    });
+    return { symbols, returns };
+}
+
+function parseMapSymbol(file, symbol) {
+    const m = new RegExp(`^\\s+0x([0-9a-f]+)\\s+${symbol}\\s*$`, 'm').exec(fs.readFileSync(file, 'utf8'));
+    if (!m) throw new Error(`${symbol} not found in ${file}`);
+    return parseInt(m[1], 16);
+}
+
+// Renode monitor commands installing the measurement hooks
+function buildHooks(listing, uwTick) {
+    const tick = `machine.SystemBus.ReadDoubleWord(0x${uwTick.toString(16)})`;
+    const hook = (addr, body) => `sysbus.cpu AddHook 0x${addr.toString(16)} "${body}"`;
+    const log = (fmt, args) => `self.DebugLog('BENCH %d ${fmt}' % (${tick}${args ? ', ' + args : ''}))`;
+    const reg = (n) => `self.GetRegisterUnsafe(${n}).RawValue`;
+    const hooks = [];
+    const entry = (name) => listing.symbols.get(name);
+
+    ISRS.filter(entry).forEach((isr) => hooks.push(hook(entry(isr), log(`isr ${isr}`))));
+
+    hooks.push(hook(entry('HAL_UART_Transmit'),
+        `s=''.join([chr(b) for b in machine.SystemBus.ReadBytes(${reg(1)}, min(${reg(2)} & 0xffff, 96))]).strip(); ` +
+        log('tx %s', 's')));
+
+    listing.returns.get('ESP8266_WaitForResponse').forEach((addr) => hooks.push(hook(addr, log('ret %d', reg(0)))));
+
+    hooks.push(hook(entry('HAL_Delay'), log('delay-enter')));
+    listing.returns.get('HAL_Delay').forEach((addr) => hooks.push(hook(addr, log('delay-leave'))));
+
+    hooks.push(hook(entry('LED_Control'), log('led %d', reg(0))));
+    return hooks;
+}
+
+// ---- Renode / simulator plumbing -----------------------------------------------
+
+function startRenode(build, opts, work) {
+    const listing = parseListing(path.join(build.dir, 'mqtt_dashboard.list'));
+    const uwTick = parseMapSymbol(path.join(build.dir, 'mqtt_dashboard.map'), 'uwTick');
+
+    // Renode paths cannot contain spaces ("DMA Version"), so run from a copy
+    const elf = path.join(work, 'mqtt_dashboard.elf');
+    fs.copyFileSync(path.join(build.dir, 'mqtt_dashboard.elf'), elf);
+
+    const script = path.join(work, 'bench.resc');
+    fs.writeFileSync(script, [
+        `$elf=@${elf}`,
+        `$esp_port=${opts.port}`,
+        `include @${path.join(__dirname, 'dashboard.resc')}`,
+        'logLevel 3',
+        'logLevel 0 sysbus.cpu',
+        ...buildHooks(listing, uwTick),
+        'start'
+    ].join('\n') + '\n');
+
+    const renode = spawn(opts.renode, ['--disable-xwt', '--console', '--plain', script],
+        { stdio: ['pipe', 'pipe', 'inherit'] });
+    renode.on('error', (err) => {
+        console.error(`Cannot start Renode (${err.message}); pass --renode <path>`);
+        process.exit(1);
+    });
+
+    const events = [];
+    let pending = '';
+    renode.stdout.on('data', (chunk) => {
+        const lines = (pending + chunk.toString()).split('\n');
+        pending = lines.pop();
+        lines.forEach((line) => {
+            const m = /BENCH (\d+) (\S+) ?(.*?)\s*$/.exec(line);
+            if (m) events.push({ tick: parseInt(m[1], 10), kind: m[2], arg: m[3] });
+        });
+    });
+    return { renode, events };
+}
+
+function connectSimulator(opts) {
+    const deadline = Date.now() + 30000;
+    return new Promise((resolve, reject) => {
+        const attempt = () => {
+            const socket = net.connect(opts.port, 'localhost', () => {
+                socket.setNoDelay(true);
+                resolve(new Esp8266Simulator(socket, socket, {
+                    broker: 'none', delay: 0, jitter: 0, bootDelay: 50, wifiDelay: 50, seed: opts.seed
+                }));
+            });
+            socket.on('error', () => {
+                if (Date.now() > deadline) reject(new Error('Renode socket terminal not reachable'));
+                else setTimeout(attempt, 200);
+            });
+        };
+        attempt();
+    });
+}
+
+// Also matches command names such as "AT+MQTTPUB <device id>/led/status"
+function isStatusTopic(topic) {
+    return /(^|[ /])led\/status$/.test(topic);
+}
+
+function waitForStatus(sim, timeout) {
+    return new Promise((resolve, reject) => {
+        const timer = setTimeout(() => {
+            sim.removeListener('publish', onPublish);
+            reject(new Error('timed out waiting for led/status'));
+        }, timeout);
+        // "led/status" or, with per-device topics, "<device id>/led/status"
+        const onPublish = (topic) => {
+            if (!isStatusTopic(topic)) return;
+            clearTimeout(timer);
+            sim.removeListener('publish', onPublish);
+            resolve(topic);
+        };
+        sim.on('publish', onPublish);
+    });
+}
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// ---- Analysis -------------------------------------------------------------------
+
+function commandName(text) {
+    const m = /^(AT[^=]*)(?:=0,"([^"]*)")?/.exec(text);
+    if (!m) return text;
+    return m[1] === 'AT+MQTTPUB' || m[1] === 'AT+MQTTSUB' ? `${m[1]} ${m[2]}` : m[1];
+}
+
+function summarize(samples) {
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        count: sorted.length,
+        mean: sorted.reduce((a, b) => a + b, 0) / sorted.length,
+        p50: pick(0.5),
+        p95: pick(0.95),
+        max: sorted[sorted.length - 1]
+    };
+}
+
+function analyze(events, windowStart, windowEnd) {
+    const window = events.slice(windowStart, windowEnd);
+    const t0 = window.length ? window[0].tick : 0;
+    const t1 = window.length ? window[window.length - 1].tick : 0;
+
+    // CPU busy = time in the traffic window not spent spinning in HAL_Delay
+    let delayTicks = 0;
+    let delayStart = null;
+    const isrCounts = {};
+    window.forEach((e) => {
+        if (e.kind === 'delay-enter') delayStart = e.tick;
+        else if (e.kind === 'delay-leave' && delayStart !== null) {
+            delayTicks += e.tick - delayStart;
+            delayStart = null;
+        } else if (e.kind === 'isr') isrCounts[e.arg] = (isrCounts[e.arg] || 0) + 1;
+    });
+
+    // AT command latency: UART transmit -> ESP8266_WaitForResponse() return
+    const latencies = {};
+    const controlRtt = [];
+    let tx = null;
+    let ledTick = null;
+    events.slice(0, windowEnd).forEach((e, index) => {
+        if (e.kind === 'tx') {
+            tx = { name: commandName(e.arg), tick: e.tick };
+        } else if (e.kind === 'ret' && tx) {
+            (latencies[tx.name] = latencies[tx.name] || []).push(e.tick - tx.tick);
+            if (index >= windowStart && ledTick !== null && isStatusTopic(tx.name)) {
+                controlRtt.push(e.tick - ledTick);
+                ledTick = null;
+            }
+            tx = null;
+        } else if (e.kind === 'led' && index >= windowStart) {
+            ledTick = e.tick;
+        }
+    });
+
+    const elapsed = Math.max(1, t1 - t0);
+    return {
+        windowTicks: elapsed,
+        cpuBusyPercent: 100 * (1 - delayTicks / elapsed),
+        isr: Object.fromEntries(Object.entries(isrCounts).map(([k, v]) => [k, { count: v, perSecond: v * 1000 / elapsed }])),
+        commands: Object.fromEntries(Object.entries(latencies).map(([k, v]) => [k, summarize(v)])),
+        ledToStatusAck: controlRtt.length ? summarize(controlRtt) : null
+    };
+}
+
+// ---- Main -----------------------------------------------------------------------
+
+async function runBuild(build, opts) {
+    const work = fs.mkdtempSync(path.join(os.tmpdir(), 'renode-bench-'));
+    const { renode, events } = startRenode(build, opts, work);
+    let sim = null;
+
+    try {
+        sim = await connectSimulator(opts);
+        console.error(`${build.name}: waiting for firmware to connect...`);
+        const statusTopic = await waitForStatus(sim, STARTUP_TIMEOUT_MS);
+        const controlTopic = statusTopic.replace(/status$/, 'control');
+
+        const windowStart = events.length;
+        for (let i = 0; i < opts.commands; i++) {
+            const status = waitForStatus(sim, COMMAND_TIMEOUT_MS);
+            sim.onBrokerMessage(controlTopic, Buffer.from(i % 2 === 0 ? 'on' : 'off'));
+            await status;
+            await sleep(opts.gap);
+        }
+        // Let the last publish's hooks reach stdout
+        await sleep(500);
+        return analyze(events, windowStart, events.length);
+    } finally {
+        if (sim) sim.close();
+        renode.stdin.write('quit\n');
+        setTimeout(() => renode.kill('SIGKILL'), 3000).unref();
+        await new Promise((resolve) => renode.once('exit', resolve));
+        fs.rmSync(work, { recursive: true, force: true });
+    }
+}
+
+function printReport(results) {
+    const names = Object.keys(results);
+    const col = (v) => String(v).padStart(22);
+    const fmt = (v, digits = 1) => (v === undefined || v === null ? '-' : v.toFixed(digits));
+    const row = (label, fn) => console.log(label.padEnd(34) + names.map((n) => col(fn(results[n]))).join(''));
+
+    console.log(''.padEnd(34) + names.map(col).join(''));
+    row('CPU busy (% of window)', (r) => fmt(r.cpuBusyPercent));
+    row('LED applied -> status OK (ms p50)', (r) => fmt(r.ledToStatusAck && r.ledToStatusAck.p50, 0));
+
+    const isrs = new Set(names.flatMap((n) => Object.keys(results[n].isr)));
+    isrs.forEach((isr) => row(`${isr} (/s)`, (r) => fmt(r.isr[isr] && r.isr[isr].perSecond)));
+
+    const commands = new Set(names.flatMap((n) => Object.keys(results[n].commands)));
+    [...commands].sort().forEach((cmd) => row(`${cmd} (ms mean)`, (r) => fmt(r.commands[cmd] && r.commands[cmd].mean)));
+}
+
+async function main() {
+    const opts = parseCommandLine(process.argv.slice(2));
+    const selected = opts.build === 'both' ? ['dma', 'it'] : [opts.build];
+    const results = {};
+
+    for (const key of selected) {
+        results[BUILDS[key].name] = await runBuild(BUILDS[key], opts);
+    }
+
+    printReport(results);
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify({ options: opts, results }, null, 2));
+    }
+}
+
+main().catch((err) => {
+    console.error(err.message);
+    process.exit(1);
+});
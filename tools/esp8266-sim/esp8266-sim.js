@@ -0,0 +1,505 @@
+#!/usr/bin/env node
+// ESP8266 AT firmware simulator
+//
+// Speaks the subset of the ESP-AT command set used by Core/Src/esp8266.c
+// (AT, ATE0/ATE1, AT+RST, AT+CWMODE, AT+CWQAP, AT+CWJAP, AT+MQTTUSERCFG,
+// AT+MQTTCONN, AT+MQTTSUB, AT+MQTTPUB) and raises +MQTTSUBRECV URCs, so the
+// firmware and the dashboard server can be exercised without a module.
+//
+// MQTT traffic is bridged to a real broker (default mqtt://localhost:1883),
+// or looped back internally with --broker none.
+//
+// Usage:
+//   node esp8266-sim.js --pty /tmp/ttyESP8266     (needs socat)
+//   node esp8266-sim.js --tcp 3456                (listen, e.g. for QEMU)
+//   node esp8266-sim.js --connect localhost:3456  (dial, e.g. Renode)
+//   node esp8266-sim.js --stdio
+//
+// Timing / fault injection:
+//   --delay <ms>          base response delay (default 5)
+//   --jitter <ms>         uniform +/- jitter added to every delay
+//   --error-rate <p>      probability a command answers ERROR / FAIL
+//   --drop-rate <p>       probability a command gets no answer at all
+//   --corrupt-rate <p>    probability one byte of a response is flipped
+//   --boot-delay <ms>     AT+RST -> "ready" (default 500)
+//   --wifi-delay <ms>     AT+CWJAP association time (default 1500)
+//   --seed <n>            PRNG seed for reproducible runs
+//   --stats-json <file>   write per-command latency stats on exit
+//   --verbose             log every line in both directions to stderr
+
+const net = require('net');
+const fs = require('fs');
+const { spawn } = require('child_process');
+const { EventEmitter } = require('events');
+
+const DEFAULTS = {
+    broker: 'mqtt://localhost:1883',
+    delay: 5,
+    jitter: 0,
+    errorRate: 0,
+    dropRate: 0,
+    corruptRate: 0,
+    bootDelay: 500,
+    wifiDelay: 1500,
+    seed: Date.now() >>> 0,
+    verbose: false
+};
+
+// Small seeded PRNG (mulberry32) so fault injection is reproducible
+function createRandom(seed) {
+    let a = seed >>> 0;
+    return () => {
+        a = (a + 0x6D2B79F5) >>> 0;
+        let t = a;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+// Split AT arguments on commas, honouring "quoted" strings and \-escapes
+function parseArgs(text) {
+    const args = [];
+    let current = '';
+    let quoted = false;
+    let wasQuoted = false;
+
+    for (let i = 0; i < text.length; i++) {
+        const c = text[i];
+        if (c === '\\' && i + 1 < text.length) {
+            current += text[++i];
+        } else if (c === '"') {
+            quoted = !quoted;
+            wasQuoted = true;
+        } else if (c === ',' && !quoted) {
+            args.push(wasQuoted ? current : current.trim());
+            current = '';
+            wasQuoted = false;
+        } else {
+            current += c;
+        }
+    }
+    args.push(wasQuoted ? current : current.trim());
+    return args;
+}
+
+// Loopback "broker" used with --broker none: publishes are delivered back
+// to our own subscriptions, nothing leaves the process
+class LoopbackBroker extends EventEmitter {
+    constructor() {
+        super();
+        this.topics = new Set();
+        setImmediate(() => this.emit('connect'));
+    }
+
+    subscribe(topic, opts, cb) {
+        this.topics.add(topic);
+        if (cb) setImmediate(cb, null);
+    }
+
+    publish(topic, payload, opts, cb) {
+        if (cb) setImmediate(cb, null);
+        if (this.topics.has(topic)) {
+            setImmediate(() => this.emit('message', topic, Buffer.from(payload)));
+        }
+    }
+
+    end() {
+        this.topics.clear();
+    }
+}
+
+class Esp8266Simulator extends EventEmitter {
+    constructor(input, output, options = {}) {
+        super();
+        this.input = input;
+        this.output = output;
+        this.opts = Object.assign({}, DEFAULTS, options);
+        this.random = createRandom(this.opts.seed);
+
+        this.rxLine = '';
+        this.busy = false;
+        this.stats = {};
+
+        this.resetState();
+
+        this.onData = (chunk) => this.receive(chunk);
+        this.input.on('data', this.onData);
+    }
+
+    resetState() {
+        this.echo = true;
+        this.wifiMode = 1;
+        this.uart = { baudrate: 115200, flowControl: 0 };
+        this.wifiConnected = false;
+        this.mqttClientId = '';
+        if (this.mqtt) {
+            this.mqtt.removeAllListeners();
+            this.mqtt.end(true);
+        }
+        this.mqtt = null;
+    }
+
+    close() {
+        this.input.removeListener('data', this.onData);
+        this.resetState();
+    }
+
+    // ---- Timing / fault helpers -------------------------------------------
+
+    delay(base) {
+        const jitter = this.opts.jitter ? (this.random() * 2 - 1) * this.opts.jitter : 0;
+        return Math.max(0, base + this.opts.delay + jitter);
+    }
+
+    chance(p) {
+        return p > 0 && this.random() < p;
+    }
+
+    write(text) {
+        let data = Buffer.from(text, 'latin1');
+        if (this.chance(this.opts.corruptRate) && data.length > 0) {
+            const i = Math.floor(this.random() * data.length);
+            data[i] ^= 1 << Math.floor(this.random() * 8);
+        }
+        if (this.opts.verbose) {
+            process.stderr.write(`<< ${JSON.stringify(data.toString('latin1'))}\n`);
+        }
+        this.output.write(data);
+    }
+
+    record(name, start) {
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+        const s = this.stats[name] || (this.stats[name] = { count: 0, total: 0, min: Infinity, max: 0 });
+        s.count++;
+        s.total += elapsed;
+        s.min = Math.min(s.min, elapsed);
+        s.max = Math.max(s.max, elapsed);
+    }
+
+    // ---- UART receive path --------------------------------------------------
+
+    receive(chunk) {
+        for (const byte of chunk) {
+            if (byte === 0x0A) {
+                const line = this.rxLine.replace(/\r$/, '');
+                this.rxLine = '';
+                if (line.length > 0) this.enqueue(line);
+            } else {
+                this.rxLine += String.fromCharCode(byte);
+            }
+        }
+    }
+
+    enqueue(line) {
+        if (this.opts.verbose) {
+            process.stderr.write(`>> ${JSON.stringify(line)}\n`);
+        }
+        if (this.echo) this.write(`${line}\r\n`);
+
+        // Real firmware rejects commands while one is still executing
+        if (this.busy) {
+            this.write('busy p...\r\n');
+            return;
+        }
+        this.busy = true;
+        this.execute(line, process.hrtime.bigint());
+    }
+
+    // Finish the current command with a final result code
+    finish(name, start, text, baseDelay = 0) {
+        setTimeout(() => {
+            this.write(text);
+            this.record(name, start);
+            this.busy = false;
+            this.emit('command', name);
+        }, this.delay(baseDelay));
+    }
+
+    execute(line, start) {
+        const match = /^AT(?:([+][A-Z_]+)(?:=(.*))?|(E[01]))?$/.exec(line);
+        const name = match ? (match[1] || match[3] || 'AT') : 'UNKNOWN';
+
+        if (!match || !this.handlers[name]) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        if (this.chance(this.opts.dropRate)) {
+            // Swallow the command entirely: the driver will time out
+            this.record(`${name} (dropped)`, start);
+            this.busy = false;
+            return;
+        }
+        if (this.chance(this.opts.errorRate)) {
+            this.finish(name, start, name === '+CWJAP' ? '+CWJAP:1\r\n\r\nFAIL\r\n' : '\r\nERROR\r\n');
+            return;
+        }
+
+        this.handlers[name].call(this, name, match[2] === undefined ? [] : parseArgs(match[2]), start);
+    }
+
+    // ---- MQTT bridge --------------------------------------------------------
+
+    connectBroker(host, port, callback) {
+        let client;
+        if (this.opts.broker === 'none') {
+            client = new LoopbackBroker();
+        } else {
+            const mqtt = require('mqtt');
+            client = mqtt.connect(this.opts.broker, {
+                clientId: this.mqttClientId || `esp8266-sim-${process.pid}`,
+                reconnectPeriod: 0,
+                connectTimeout: 5000
+            });
+        }
+
+        const onConnect = () => {
+            client.removeListener('error', onError);
+            callback(null, client);
+        };
+        const onError = (err) => {
+            client.removeListener('connect', onConnect);
+            client.end(true);
+            callback(err);
+        };
+        client.once('connect', onConnect);
+        client.once('error', onError);
+    }
+
+    onBrokerMessage(topic, payload) {
+        const data = payload.toString('latin1');
+        setTimeout(() => {
+            this.write(`+MQTTSUBRECV:0,"${topic}",${Buffer.byteLength(data, 'latin1')},${data}\r\n`);
+        }, this.delay(0));
+    }
+}
+
+Esp8266Simulator.prototype.handlers = {
+    'AT'(name, args, start) {
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    'E0'(name, args, start) {
+        this.echo = false;
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    'E1'(name, args, start) {
+        this.echo = true;
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    '+RST'(name, args, start) {
+        this.finish(name, start, '\r\nOK\r\n');
+        setTimeout(() => {
+            this.resetState();
+            // ROM bootloader noise at 74880 baud shows up as garbage bytes
+            this.output.write(Buffer.from([0x00, 0xFF, 0x8A, 0x12, 0xFE]));
+            this.write('\r\n ets Jan  8 2013,rst cause:2, boot mode:(3,7)\r\n\r\nready\r\n');
+            this.emit('reset');
+        }, this.delay(this.opts.bootDelay));
+    },
+
+    '+CWMODE'(name, args, start) {
+        const mode = parseInt(args[0], 10);
+        if (!(mode >= 0 && mode <= 3)) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        this.wifiMode = mode;
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    '+UART_CUR'(name, args, start) {
+        // <baudrate>,<databits>,<stopbits>,<parity>,<flow control>
+        const [baudrate, dataBits, stopBits, parity, flowControl] = args.map((a) => parseInt(a, 10));
+        if (args.length !== 5 || !(baudrate >= 80 && baudrate <= 5000000) ||
+            !(dataBits >= 5 && dataBits <= 8) || !(stopBits >= 1 && stopBits <= 3) ||
+            !(parity >= 0 && parity <= 2) || !(flowControl >= 0 && flowControl <= 3)) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        // A pty or TCP link has no line rate; just remember what was asked for
+        this.uart = { baudrate, flowControl };
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    '+CWQAP'(name, args, start) {
+        const wasConnected = this.wifiConnected;
+        this.wifiConnected = false;
+        this.finish(name, start, wasConnected ? '\r\nOK\r\nWIFI DISCONNECT\r\n' : '\r\nOK\r\n');
+    },
+
+    '+CWJAP'(name, args, start) {
+        if (args.length < 2 || (this.wifiMode !== 1 && this.wifiMode !== 3)) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        this.wifiConnected = true;
+        this.finish(name, start, 'WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n', this.opts.wifiDelay);
+    },
+
+    '+MQTTUSERCFG'(name, args, start) {
+        if (args.length < 8 || args[0] !== '0') {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        this.mqttClientId = args[2];
+        this.finish(name, start, '\r\nOK\r\n');
+    },
+
+    '+MQTTCONN'(name, args, start) {
+        if (args.length < 4 || !this.wifiConnected || !this.mqttClientId) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        const [, host, port, reconnect] = args;
+
+        this.connectBroker(host, port, (err, client) => {
+            if (err) {
+                process.stderr.write(`esp8266-sim: broker connect failed: ${err.message}\n`);
+                this.finish(name, start, '\r\nERROR\r\n');
+                return;
+            }
+            this.mqtt = client;
+            client.on('message', (topic, payload) => this.onBrokerMessage(topic, payload));
+            client.on('error', (e) => process.stderr.write(`esp8266-sim: broker error: ${e.message}\n`));
+            client.on('close', () => {
+                if (this.mqtt === client) {
+                    this.mqtt = null;
+                    this.write('+MQTTDISCONNECTED:0\r\n');
+                }
+            });
+            this.finish(name, start,
+                `+MQTTCONNECTED:0,1,"${host}","${port}","",${reconnect}\r\n\r\nOK\r\n`);
+        });
+    },
+
+    '+MQTTSUB'(name, args, start) {
+        if (args.length < 3 || !this.mqtt) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        this.mqtt.subscribe(args[1], { qos: parseInt(args[2], 10) || 0 }, (err) => {
+            this.finish(name, start, err ? '\r\nERROR\r\n' : '\r\nOK\r\n');
+        });
+    },
+
+    '+MQTTPUB'(name, args, start) {
+        if (args.length < 5 || !this.mqtt) {
+            this.finish(name, start, '\r\nERROR\r\n');
+            return;
+        }
+        const [, topic, data, qos, retain] = args;
+        this.emit('publish', topic, data);
+        this.mqtt.publish(topic, data, { qos: parseInt(qos, 10) || 0, retain: retain === '1' }, (err) => {
+            this.finish(name, start, err ? '\r\nERROR\r\n' : '\r\nOK\r\n');
+        });
+    }
+};
+
+// ---- Command line ------------------------------------------------------------
+
+function parseCommandLine(argv) {
+    const options = {};
+    const transport = {};
+
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const next = () => argv[++i];
+
+        switch (arg) {
+            case '--pty': transport.pty = next(); break;
+            case '--tcp': transport.tcp = parseInt(next(), 10); break;
+            case '--connect': transport.connect = next(); break;
+            case '--stdio': transport.stdio = true; break;
+            case '--broker': options.broker = next(); break;
+            case '--delay': options.delay = parseFloat(next()); break;
+            case '--jitter': options.jitter = parseFloat(next()); break;
+            case '--error-rate': options.errorRate = parseFloat(next()); break;
+            case '--drop-rate': options.dropRate = parseFloat(next()); break;
+            case '--corrupt-rate': options.corruptRate = parseFloat(next()); break;
+            case '--boot-delay': options.bootDelay = parseFloat(next()); break;
+            case '--wifi-delay': options.wifiDelay = parseFloat(next()); break;
+            case '--seed': options.seed = parseInt(next(), 10); break;
+            case '--stats-json': transport.statsFile = next(); break;
+            case '--verbose': options.verbose = true; break;
+            default:
+                throw new Error(`Unknown option: ${arg}`);
+        }
+    }
+    return { options, transport };
+}
+
+function printStats(sim, statsFile) {
+    const rows = Object.keys(sim.stats).sort().map((name) => {
+        const s = sim.stats[name];
+        return { command: name, count: s.count, mean_ms: s.total / s.count, min_ms: s.min, max_ms: s.max };
+    });
+
+    process.stderr.write('\ncommand              count    mean ms     min ms     max ms\n');
+    rows.forEach((r) => {
+        process.stderr.write(`${r.command.padEnd(20)} ${String(r.count).padStart(5)} ` +
+            `${r.mean_ms.toFixed(2).padStart(10)} ${r.min_ms.toFixed(2).padStart(10)} ${r.max_ms.toFixed(2).padStart(10)}\n`);
+    });
+
+    if (statsFile) {
+        fs.writeFileSync(statsFile, JSON.stringify({ seed: sim.opts.seed, commands: rows }, null, 2));
+    }
+}
+
+function main() {
+    const { options, transport } = parseCommandLine(process.argv.slice(2));
+    let sim = null;
+
+    const attach = (input, output) => {
+        if (sim) sim.close();
+        sim = new Esp8266Simulator(input, output, options);
+        return sim;
+    };
+
+    if (transport.pty) {
+        // socat owns the pty; we talk to it over its stdio
+        const socat = spawn('socat', [`PTY,link=${transport.pty},raw,echo=0`, 'STDIO'],
+            { stdio: ['pipe', 'pipe', 'inherit'] });
+        socat.on('error', (err) => {
+            console.error(`esp8266-sim: cannot start socat (${err.message})`);
+            process.exit(1);
+        });
+        socat.on('exit', () => process.exit(0));
+        attach(socat.stdout, socat.stdin);
+        console.error(`ESP8266 simulator listening on ${transport.pty}`);
+    } else if (transport.tcp) {
+        net.createServer((socket) => {
+            socket.setNoDelay(true);
+            attach(socket, socket);
+            console.error(`ESP8266 simulator: UART peer connected from ${socket.remoteAddress}`);
+        }).listen(transport.tcp, () => {
+            console.error(`ESP8266 simulator listening on tcp port ${transport.tcp}`);
+        });
+    } else if (transport.connect) {
+        const [host, port] = transport.connect.split(':');
+        const socket = net.connect(parseInt(port, 10), host, () => {
+            socket.setNoDelay(true);
+            attach(socket, socket);
+            console.error(`ESP8266 simulator connected to ${transport.connect}`);
+        });
+        socket.on('close', () => process.exit(0));
+    } else if (transport.stdio) {
+        attach(process.stdin, process.stdout);
+    } else {
+        console.error('Specify one of --pty <path>, --tcp <port>, --connect <host:port> or --stdio');
+        process.exit(1);
+    }
+
+    process.on('SIGINT', () => {
+        if (sim) printStats(sim, transport.statsFile);
+        process.exit(0);
+    });
+}
+
+module.exports = { Esp8266Simulator, LoopbackBroker, parseArgs };
+
+if (require.main === module) {
+    main();
+}
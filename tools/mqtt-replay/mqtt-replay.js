@@ -0,0 +1,500 @@
+#!/usr/bin/env node
+// MQTT traffic recorder and replayer for load-testing the dashboard server
+//
+//   record    subscribe to the project's topics and write every message,
+//             with its arrival time, to a recording file
+//   replay    publish a recording to a broker at 1x, Nx or maximum speed,
+//             optionally multiplying the fleet, while sampling the
+//             server's /metrics
+//   generate  write a synthetic recording of a fleet (steady toggling plus
+//             every board reconnecting after a WiFi outage)
+//   info      summarize a recording (messages, topics, peak rate)
+//
+// Recording format (little endian):
+//
+//   header   "MQRC", u8 version (1), f64 start time (ms since the epoch)
+//   TOPIC    u8 1, u16 topic index, u16 length, topic (UTF-8)
+//            defines an index before its first use
+//   MESSAGE  u8 2, u8 flags (bits 0-1 QoS, bit 2 retain), u16 topic index,
+//            u32 µs since the previous message, u32 length, payload
+//   TIME     u8 3, f64 ms since the start
+//            written instead of a delta that does not fit in 32 bits
+//
+// Topics are stored once, so a status update costs 12 bytes plus its payload.
+
+const fs = require('fs');
+
+const MAGIC = 'MQRC';
+const VERSION = 1;
+const FILE_HEADER = 13;
+const REC_TOPIC = 1;
+const REC_MESSAGE = 2;
+const REC_TIME = 3;
+const MAX_DELTA_US = 0xFFFFFFFF;
+
+const DEFAULT_TOPICS = ['+/led/#', 'led/#'];
+
+// ---- Recording file -------------------------------------------------------
+
+class RecordingWriter {
+    constructor(file, start = Date.now()) {
+        this.fd = fs.openSync(file, 'w');
+        this.start = start;
+        this.topics = new Map();
+        this.lastUs = 0;
+        this.chunks = [];
+        this.pending = 0;
+        this.count = 0;
+
+        const header = Buffer.alloc(FILE_HEADER);
+        header.write(MAGIC, 0, 'latin1');
+        header.writeUInt8(VERSION, 4);
+        header.writeDoubleLE(start, 5);
+        this.push(header);
+    }
+
+    push(buffer) {
+        this.chunks.push(buffer);
+        this.pending += buffer.length;
+        if (this.pending >= 64 * 1024) {
+            this.flush();
+        }
+    }
+
+    topicIndex(topic) {
+        let index = this.topics.get(topic);
+        if (index === undefined) {
+            index = this.topics.size;
+            this.topics.set(topic, index);
+            const name = Buffer.from(topic, 'utf8');
+            const record = Buffer.alloc(5 + name.length);
+            record.writeUInt8(REC_TOPIC, 0);
+            record.writeUInt16LE(index, 1);
+            record.writeUInt16LE(name.length, 3);
+            name.copy(record, 5);
+            this.push(record);
+        }
+        return index;
+    }
+
+    // time: ms since the epoch (fractions allowed)
+    write(time, topic, payload, qos = 0, retain = false) {
+        const index = this.topicIndex(topic);
+        const us = Math.max(this.lastUs, Math.round((time - this.start) * 1000));
+        let delta = us - this.lastUs;
+
+        if (delta > MAX_DELTA_US) {
+            const record = Buffer.alloc(9);
+            record.writeUInt8(REC_TIME, 0);
+            record.writeDoubleLE(us / 1000, 1);
+            this.push(record);
+            delta = 0;
+        }
+        this.lastUs = us;
+
+        const data = Buffer.isBuffer(payload) ? payload : Buffer.from(String(payload));
+        const record = Buffer.alloc(12 + data.length);
+        record.writeUInt8(REC_MESSAGE, 0);
+        record.writeUInt8((qos & 3) | (retain ? 4 : 0), 1);
+        record.writeUInt16LE(index, 2);
+        record.writeUInt32LE(delta, 4);
+        record.writeUInt32LE(data.length, 8);
+        data.copy(record, 12);
+        this.push(record);
+        this.count++;
+    }
+
+    flush() {
+        if (this.pending > 0) {
+            fs.writeSync(this.fd, Buffer.concat(this.chunks, this.pending));
+            this.chunks = [];
+            this.pending = 0;
+        }
+    }
+
+    close() {
+        this.flush();
+        fs.closeSync(this.fd);
+    }
+}
+
+// Yields { offset (ms since the start), topic, payload, qos, retain }
+function* readRecording(file) {
+    const data = fs.readFileSync(file);
+    if (data.toString('latin1', 0, 4) !== MAGIC || data.readUInt8(4) !== VERSION) {
+        throw new Error(`${file} is not an MQTT recording`);
+    }
+    const topics = [];
+    let us = 0;
+    let pos = FILE_HEADER;
+
+    while (pos < data.length) {
+        const type = data.readUInt8(pos);
+        if (type === REC_TOPIC) {
+            const length = data.readUInt16LE(pos + 3);
+            topics[data.readUInt16LE(pos + 1)] = data.toString('utf8', pos + 5, pos + 5 + length);
+            pos += 5 + length;
+        } else if (type === REC_TIME) {
+            us = Math.round(data.readDoubleLE(pos + 1) * 1000);
+            pos += 9;
+        } else if (type === REC_MESSAGE) {
+            const flags = data.readUInt8(pos + 1);
+            const length = data.readUInt32LE(pos + 8);
+            if (pos + 12 + length > data.length) {
+                break;  // torn end of an interrupted recording
+            }
+            us += data.readUInt32LE(pos + 4);
+            yield {
+                offset: us / 1000,
+                topic: topics[data.readUInt16LE(pos + 2)],
+                payload: data.subarray(pos + 12, pos + 12 + length),
+                qos: flags & 3,
+                retain: (flags & 4) !== 0
+            };
+            pos += 12 + length;
+        } else {
+            throw new Error(`corrupt recording at byte ${pos}`);
+        }
+    }
+}
+
+function recordingStart(file) {
+    const header = Buffer.alloc(FILE_HEADER);
+    const fd = fs.openSync(file, 'r');
+    fs.readSync(fd, header, 0, FILE_HEADER, 0);
+    fs.closeSync(fd);
+    return header.readDoubleLE(5);
+}
+
+// ---- Helpers --------------------------------------------------------------
+
+function summarize(samples) {
+    if (samples.length === 0) {
+        return { count: 0, p50: 0, p99: 0, max: 0 };
+    }
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const pick = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return { count: sorted.length, p50: pick(0.5), p99: pick(0.99), max: sorted[sorted.length - 1] };
+}
+
+const now = () => Number(process.hrtime.bigint()) / 1e6;
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+function connect(url, clientId) {
+    const mqtt = require('mqtt');
+    const client = mqtt.connect(url, { clientId, clean: true });
+    return new Promise((resolve, reject) => {
+        client.once('connect', () => resolve(client));
+        client.once('error', reject);
+    });
+}
+
+// Device "<id>" -> "<id>-<copy>" for the extra copies of a multiplied fleet
+function cloneTopic(topic, copy) {
+    if (copy === 0) {
+        return topic;
+    }
+    const slash = topic.indexOf('/');
+    if (topic.startsWith('led/') || slash <= 0) {
+        return `default-${copy}/${topic}`;
+    }
+    return `${topic.slice(0, slash)}-${copy}${topic.slice(slash)}`;
+}
+
+// Selected values from a Prometheus text page
+function parseMetrics(text) {
+    const values = {};
+    for (const line of text.split('\n')) {
+        const match = /^([a-z_]+(?:\{[^}]*\})?) ([\d.e+-]+)$/.exec(line);
+        if (match) {
+            values[match[1]] = parseFloat(match[2]);
+        }
+    }
+    return values;
+}
+
+// Sample the server's /metrics once a second while replaying
+function watchServer(url) {
+    const samples = [];
+    let previous = null;
+    let stopped = false;
+
+    const poll = async () => {
+        while (!stopped) {
+            try {
+                const values = parseMetrics(await (await fetch(url)).text());
+                const t = now();
+                if (previous) {
+                    const seconds = (t - previous.t) / 1000;
+                    const rate = (name) => ((values[name] || 0) - (previous.values[name] || 0)) / seconds;
+                    const lagCount = (values.eventloop_lag_ms_count || 0) - (previous.values.eventloop_lag_ms_count || 0);
+                    const lagSum = (values.eventloop_lag_ms_sum || 0) - (previous.values.eventloop_lag_ms_sum || 0);
+                    samples.push({
+                        mqttInPerSec: rate('mqtt_messages_received_total'),
+                        wsOutPerSec: rate('ws_messages_sent_total'),
+                        eventLoopLagMs: lagCount > 0 ? lagSum / lagCount : 0,
+                        heapMB: (values.process_heap_used_bytes || 0) / 1048576,
+                        clients: values.ws_connections || 0
+                    });
+                }
+                previous = { t, values };
+            } catch (error) {
+                samples.push({ error: error.message });
+            }
+            await sleep(1000);
+        }
+    };
+    const running = poll();
+
+    return async () => {
+        stopped = true;
+        await running;
+        return samples;
+    };
+}
+
+// ---- Commands -------------------------------------------------------------
+
+async function record(opts) {
+    const client = await connect(opts.broker, `mqtt-recorder-${process.pid}`);
+    const writer = new RecordingWriter(opts.file);
+    client.subscribe(opts.topics, { qos: 1 });
+    console.log(`Recording ${opts.topics.join(', ')} from ${opts.broker} to ${opts.file} (Ctrl+C to stop)`);
+
+    client.on('message', (topic, payload, packet) => {
+        writer.write(performance.timeOrigin + performance.now(), topic, payload, packet.qos, packet.retain);
+    });
+    const stop = () => {
+        writer.close();
+        console.log(`\n${writer.count} messages written to ${opts.file}`);
+        client.end(true, () => process.exit(0));
+    };
+    process.on('SIGINT', stop);
+    process.on('SIGTERM', stop);
+    if (opts.duration > 0) {
+        setTimeout(stop, opts.duration * 1000);
+    }
+}
+
+async function replay(opts) {
+    const messages = Array.from(readRecording(opts.file));
+    if (messages.length === 0) {
+        console.log('Recording is empty');
+        return;
+    }
+    const client = await connect(opts.broker, `mqtt-replay-${process.pid}`);
+    const speed = opts.speed === 'max' ? Infinity : parseFloat(opts.speed);
+    const stopWatching = opts.metrics ? watchServer(opts.metrics) : null;
+
+    console.log(`Replaying ${messages.length} messages x${opts.fleet} devices, ${opts.loops} loop(s), ` +
+        `speed ${opts.speed} to ${opts.broker}`);
+
+    const lag = [];
+    let published = 0;
+    let inFlight = 0;
+    const start = now();
+    const span = messages[messages.length - 1].offset;
+
+    for (let loop = 0; loop < opts.loops; loop++) {
+        const loopStart = speed === Infinity ? 0 : loop * (span + 1) / speed;
+        for (const message of messages) {
+            if (speed !== Infinity) {
+                const due = start + loopStart + message.offset / speed;
+                const wait = due - now();
+                if (wait > 1) {
+                    await sleep(wait - 1);
+                }
+                while (now() < due) {
+                    // spin out the last millisecond for accurate timing
+                }
+                lag.push(now() - due);
+            } else if (inFlight > 1000) {
+                // Let the socket drain so maximum speed does not just fill memory
+                await new Promise((resolve) => setImmediate(resolve));
+            }
+
+            for (let copy = 0; copy < opts.fleet; copy++) {
+                inFlight++;
+                client.publish(cloneTopic(message.topic, copy), message.payload,
+                    { qos: opts.qos !== null ? opts.qos : message.qos, retain: message.retain }, () => {
+                        inFlight--;
+                    });
+                published++;
+            }
+        }
+    }
+    while (inFlight > 0) {
+        await sleep(5);
+    }
+    const elapsed = now() - start;
+    await sleep(opts.settle);
+    const server = stopWatching ? await stopWatching() : null;
+    client.end();
+
+    const lagStats = summarize(lag);
+    const result = {
+        published,
+        elapsedMs: elapsed,
+        recordedMs: span * opts.loops,
+        ratePerSec: published / (elapsed / 1000),
+        scheduleLagMs: lagStats,
+        server
+    };
+    console.log(`Published ${published} messages in ${(elapsed / 1000).toFixed(2)} s ` +
+        `(${result.ratePerSec.toFixed(0)} msg/s; recorded span ${(span / 1000).toFixed(2)} s)`);
+    if (lag.length > 0) {
+        console.log(`Schedule lag: p50 ${lagStats.p50.toFixed(2)} ms, p99 ${lagStats.p99.toFixed(2)} ms, max ${lagStats.max.toFixed(2)} ms`);
+    }
+    if (server) {
+        console.log('server  mqtt in/s  ws out/s  loop lag (ms)  heap (MB)  clients');
+        server.forEach((s, i) => {
+            if (s.error) {
+                console.log(`${String(i + 1).padStart(5)}s  ${s.error}`);
+            } else {
+                console.log(`${String(i + 1).padStart(5)}s${s.mqttInPerSec.toFixed(0).padStart(11)}${s.wsOutPerSec.toFixed(0).padStart(10)}` +
+                    `${s.eventLoopLagMs.toFixed(1).padStart(15)}${s.heapMB.toFixed(1).padStart(11)}${String(s.clients).padStart(9)}`);
+            }
+        });
+    }
+    if (opts.json) {
+        fs.writeFileSync(opts.json, JSON.stringify(result, null, 2));
+        console.log(`Results written to ${opts.json}`);
+    }
+}
+
+// Steady toggling, then a WiFi outage after which every board reconnects
+// and publishes its boot status within `reconnectWindow` seconds
+function generate(opts) {
+    const writer = new RecordingWriter(opts.file, Date.now());
+    const deviceId = (i) => `sim${String(i).padStart(5, '0')}`;
+    const events = [];
+    let seed = opts.seed;
+    const random = () => {
+        seed = (seed * 1103515245 + 12345) % 2147483648;
+        return seed / 2147483648;
+    };
+
+    for (let i = 0; i < opts.devices; i++) {
+        let seq = 0;
+        let on = false;
+        // Boot, then toggles at an average of `rate` per device per second
+        events.push([random() * 1000, deviceId(i), `STM32 Connected - LED: OFF #${seq}`]);
+        for (let t = 1000 + random() * 1000 / opts.rate; t < opts.outageAt * 1000; t += -Math.log(1 - random()) * 1000 / opts.rate) {
+            on = !on;
+            events.push([t, deviceId(i), `LED: ${on ? 'ON' : 'OFF'} #${++seq}`]);
+        }
+        // Outage: silence, then reconnect with the boot status
+        const back = (opts.outageAt + opts.outage) * 1000 + random() * opts.reconnectWindow * 1000;
+        events.push([back, deviceId(i), `STM32 Connected - LED: ${on ? 'ON' : 'OFF'} #0`]);
+    }
+    events.sort((a, b) => a[0] - b[0]);
+    for (const [t, id, payload] of events) {
+        writer.write(writer.start + t, `${id}/led/status`, payload, 1, false);
+    }
+    writer.close();
+    console.log(`Wrote ${events.length} messages from ${opts.devices} devices to ${opts.file}`);
+}
+
+function info(opts) {
+    const perSecond = new Map();
+    const topics = new Set();
+    let count = 0;
+    let bytes = 0;
+    let last = 0;
+    for (const message of readRecording(opts.file)) {
+        count++;
+        bytes += message.payload.length;
+        topics.add(message.topic);
+        last = message.offset;
+        const second = Math.floor(message.offset / 1000);
+        perSecond.set(second, (perSecond.get(second) || 0) + 1);
+    }
+    const size = fs.statSync(opts.file).size;
+    const peak = Math.max(0, ...perSecond.values());
+    console.log(`Recorded:   ${new Date(recordingStart(opts.file)).toISOString()}`);
+    console.log(`Duration:   ${(last / 1000).toFixed(2)} s`);
+    console.log(`Messages:   ${count} on ${topics.size} topics (${(count / Math.max(last / 1000, 0.001)).toFixed(1)} msg/s average, peak ${peak} msg/s)`);
+    console.log(`File size:  ${size} bytes (${count ? (size / count).toFixed(1) : 0} per message, payloads ${bytes} bytes)`);
+}
+
+// ---- Command line ---------------------------------------------------------
+
+const USAGE = `Usage:
+  mqtt-replay.js record   <file> [--broker mqtt://localhost:1883] [--topics '+/led/#,led/#'] [--duration s]
+  mqtt-replay.js replay   <file> [--broker mqtt://localhost:1883] [--speed 1|<N>|max] [--fleet 1] [--loops 1]
+                                 [--qos 0|1] [--metrics http://localhost:3000/metrics] [--settle 2000] [--json out.json]
+  mqtt-replay.js generate <file> [--devices 1000] [--rate 0.2] [--outage-at 30] [--outage 10]
+                                 [--reconnect-window 2] [--seed 1]
+  mqtt-replay.js info     <file>`;
+
+function parseArgs(argv) {
+    const opts = {
+        command: argv[0],
+        file: argv[1],
+        broker: 'mqtt://localhost:1883',
+        topics: DEFAULT_TOPICS,
+        duration: 0,
+        speed: '1',
+        fleet: 1,
+        loops: 1,
+        qos: null,
+        metrics: null,
+        settle: 2000,
+        json: null,
+        devices: 1000,
+        rate: 0.2,
+        outageAt: 30,
+        outage: 10,
+        reconnectWindow: 2,
+        seed: 1
+    };
+    for (let i = 2; i < argv.length; i++) {
+        const value = argv[i + 1];
+        switch (argv[i]) {
+            case '--broker': opts.broker = value; break;
+            case '--topics': opts.topics = value.split(','); break;
+            case '--duration': opts.duration = parseFloat(value); break;
+            case '--speed': opts.speed = value; break;
+            case '--fleet': opts.fleet = parseInt(value, 10); break;
+            case '--loops': opts.loops = parseInt(value, 10); break;
+            case '--qos': opts.qos = parseInt(value, 10); break;
+            case '--metrics': opts.metrics = value; break;
+            case '--settle': opts.settle = parseInt(value, 10); break;
+            case '--json': opts.json = value; break;
+            case '--devices': opts.devices = parseInt(value, 10); break;
+            case '--rate': opts.rate = parseFloat(value); break;
+            case '--outage-at': opts.outageAt = parseFloat(value); break;
+            case '--outage': opts.outage = parseFloat(value); break;
+            case '--reconnect-window': opts.reconnectWindow = parseFloat(value); break;
+            case '--seed': opts.seed = parseInt(value, 10); break;
+            default:
+                console.error(`Unknown option: ${argv[i]}\n${USAGE}`);
+                process.exit(1);
+        }
+        i++;
+    }
+    if (!opts.file || !['record', 'replay', 'generate', 'info'].includes(opts.command)) {
+        console.error(USAGE);
+        process.exit(1);
+    }
+    if (opts.speed !== 'max' && !(parseFloat(opts.speed) > 0)) {
+        console.error('--speed must be a positive number or "max"');
+        process.exit(1);
+    }
+    return opts;
+}
+
+async function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    const commands = { record, replay, generate, info };
+    await commands[opts.command](opts);
+}
+
+module.exports = { RecordingWriter, readRecording, cloneTopic };
+
+if (require.main === module) {
+    main().catch((error) => {
+        console.error(error.message);
+        process.exit(1);
+    });
+}